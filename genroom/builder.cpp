@@ -244,14 +244,11 @@ namespace cinekine { namespace overview {
     //
     void Builder::paintBoxOntoMap(const TileBrush& brush, const Box& box)
     {
-        //  paint floor
-        TileHandle floorTileId = _tileTemplates.tileHandleFromDescriptor(
-                                        brush.tileCategoryId,
-                                        brush.tileClassId,
-                                        kTileRole_Floor);
+        const BrushTiles& tiles = brushTiles(brush);
 
+        //  paint floor
         Tile tile;
-        tile.floor = floorTileId;
+        tile.floor = tiles.floor;
         tile.wall = 0;
 
         cinekine::overview::Tilemap* tileMap = _map.tilemapAtZ(0);
@@ -269,82 +266,239 @@ namespace cinekine { namespace overview {
         {
             for (uint32_t xPos = box.p0.x; xPos < box.p1.x; ++xPos)
             {
-                paintTileWalls(*tileMap, yPos, xPos, brush);
+                paintTileWalls(*tileMap, yPos, xPos, tiles);
             }
         }
         for (yPos = box.p0.y; yPos < box.p1.y; ++yPos)
         {
             for (uint32_t xPos = box.p0.x; xPos < box.p1.x; ++xPos)
             {
-                paintTileWallCorners(*tileMap, yPos, xPos, brush);
+                paintTileWallCorners(*tileMap, yPos, xPos, tiles);
             }
         }
     }
 
+    //  Every wall and corner tile a brush can paint depends only on which of
+    //  a tile's four sides pass a test, so the tiles for all sixteen
+    //  combinations are looked up once, along with the results of the tests
+    //  that depend on a neighbouring tile's handle.  Painting a tile is then
+    //  a matter of building its side mask.
+    //
+    //  The tables reflect the TileDatabase when the brush is first painted.
+    //
+    auto Builder::brushTiles(const TileBrush& brush) -> const BrushTiles&
+    {
+        for (auto& tiles : _brushTiles)
+        {
+            if (tiles.brush.tileCategoryId == brush.tileCategoryId &&
+                tiles.brush.tileClassId == brush.tileClassId)
+            {
+                return tiles;
+            }
+        }
+
+        const size_t tileCount = _tileTemplates.tileCount();
+        if (_floorClassIds.empty())
+        {
+            _floorClassIds.resize(tileCount);
+            for (size_t handle = 0; handle < tileCount; ++handle)
+            {
+                _floorClassIds[handle] = _tileTemplates.tile((TileHandle)handle).classId;
+            }
+        }
 
+        _brushTiles.emplace_back();
+        BrushTiles& tiles = _brushTiles.back();
+        tiles.brush = brush;
+        tiles.floor = _tileTemplates.tileHandleFromDescriptor(brush.tileCategoryId,
+                                                              brush.tileClassId,
+                                                              kTileRole_Floor);
+        for (uint32_t sides = 0; sides < kSideMaskCount; ++sides)
+        {
+            tiles.walls[sides] =
+                _tileTemplates.tileHandleFromDescriptor(brush.tileCategoryId,
+                                                        brush.tileClassId,
+                                                        wallRoleFlags(sides));
+            tiles.corners[sides] =
+                _tileTemplates.tileHandleFromDescriptor(brush.tileCategoryId,
+                                                        brush.tileClassId,
+                                                        cornerRoleFlags(sides));
+        }
+
+        //  a neighbour's wall adds a corner on its side if the wall runs
+        //  toward this tile.
+        const uint8_t classId = brush.tileClassId;
+        tiles.cornerSides.resize(tileCount);
+        for (size_t handle = 0; handle < tileCount; ++handle)
+        {
+            const TileHandle wall = (TileHandle)handle;
+            uint8_t sides = 0;
+            if (tileWallsEqual(wall, kTileDirection_W, classId) ||
+                tileWallsEqual(wall, kTileDirection_E, classId) ||
+                tileWallsEqual(wall, kTileDirection_NW, classId) ||
+                tileWallsEqual(wall, kTileDirection_NE, classId))
+            {
+                sides |= kSide_N;
+            }
+            if (tileWallsEqual(wall, kTileDirection_N, classId) ||
+                tileWallsEqual(wall, kTileDirection_S, classId) ||
+                tileWallsEqual(wall, kTileDirection_NW, classId) ||
+                tileWallsEqual(wall, kTileDirection_SW, classId))
+            {
+                sides |= kSide_W;
+            }
+            if (tileWallsEqual(wall, kTileDirection_W, classId) ||
+                tileWallsEqual(wall, kTileDirection_E, classId) ||
+                tileWallsEqual(wall, kTileDirection_SW, classId) ||
+                tileWallsEqual(wall, kTileDirection_SE, classId))
+            {
+                sides |= kSide_S;
+            }
+            if (tileWallsEqual(wall, kTileDirection_S, classId) ||
+                tileWallsEqual(wall, kTileDirection_N, classId) ||
+                tileWallsEqual(wall, kTileDirection_NE, classId) ||
+                tileWallsEqual(wall, kTileDirection_SE, classId))
+            {
+                sides |= kSide_E;
+            }
+            tiles.cornerSides[handle] = sides;
+        }
+        return tiles;
+    }
 
+    //  calculates the sides bordering a different class of floor, which
+    //  determine the wall tile to display.
+    //
     void Builder::paintTileWalls(Tilemap& tileMap, uint32_t tileY, uint32_t tileX,
-                                const TileBrush& brush)
+                                const BrushTiles& tiles)
     {
-        const TileTemplate& thisFloorTemplate =
-            _tileTemplates.tile(tileMap.at(tileY, tileX).floor);
+        //  neighbours are only read - reading through a const map keeps a
+        //  chunked map from allocating the chunks they lie in.
+        const Tilemap& readMap = tileMap;
+        const uint8_t thisClassId = floorClassId(readMap.at(tileY, tileX).floor);
 
-        //  calculate wall masks, which are used to determine what wall tiles
-        //  to display.
-        uint16_t wallMask = kTileDirection_N | kTileDirection_E |
-            kTileDirection_W | kTileDirection_S;
+        uint32_t wallSides = kSide_N | kSide_E | kSide_S | kSide_W;
 
         if (tileY > 0 &&
-            tileFloorsClassIdEqual(tileMap.at(tileY-1, tileX), thisFloorTemplate.classId))
+            floorClassId(readMap.at(tileY-1, tileX).floor) == thisClassId)
         {
-            wallMask &= ~(kTileDirection_N);
+            wallSides &= ~kSide_N;
         }
         if (tileX > 0 &&
-            tileFloorsClassIdEqual(tileMap.at(tileY, tileX-1), thisFloorTemplate.classId))
+            floorClassId(readMap.at(tileY, tileX-1).floor) == thisClassId)
         {
-            wallMask &= ~(kTileDirection_W);
+            wallSides &= ~kSide_W;
         }
         if (tileY < tileMap.rowCount()-1 &&
-            tileFloorsClassIdEqual(tileMap.at(tileY+1, tileX), thisFloorTemplate.classId))
+            floorClassId(readMap.at(tileY+1, tileX).floor) == thisClassId)
         {
-            wallMask &= ~(kTileDirection_S);
+            wallSides &= ~kSide_S;
         }
         if (tileX < tileMap.columnCount()-1 &&
-            tileFloorsClassIdEqual(tileMap.at(tileY, tileX+1), thisFloorTemplate.classId))
+            floorClassId(readMap.at(tileY, tileX+1).floor) == thisClassId)
+        {
+            wallSides &= ~kSide_E;
+        }
+
+        Tile tile = readMap.at(tileY, tileX);
+        tile.wall = tiles.walls[wallSides];
+        tileMap.set(tileY, tileX, tile);
+    }
+
+    //  corners fill in tiles left without a wall by the first pass - tiles
+    //  painted earlier in this pass count as neighbours.
+    //
+    void Builder::paintTileWallCorners(Tilemap& tileMap, uint32_t tileY, uint32_t tileX,
+                            const BrushTiles& tiles)
+    {
+        const Tilemap& readMap = tileMap;
+        Tile thisTile = readMap.at(tileY, tileX);
+        if (thisTile.wall)
         {
-            wallMask &= ~(kTileDirection_E);
+            // this tile already has a wall - no need to run tests
+            return;
         }
 
+        //  handles out of the database's range are the empty tile, as with
+        //  TileDatabase::tile
+        auto cornerSides = [&tiles](TileHandle wall) -> uint8_t {
+            return tiles.cornerSides[wall < tiles.cornerSides.size() ? wall : 0];
+        };
+
+        uint32_t sides = kSide_N | kSide_W | kSide_S | kSide_E;
+
+        if (tileY > 0 &&
+            !(cornerSides(readMap.at(tileY-1, tileX).wall) & kSide_N))
+        {
+            sides &= ~kSide_N;
+        }
+        if (tileX > 0 &&
+            !(cornerSides(readMap.at(tileY, tileX-1).wall) & kSide_W))
+        {
+            sides &= ~kSide_W;
+        }
+        if (tileY < tileMap.rowCount()-1 &&
+            !(cornerSides(readMap.at(tileY+1, tileX).wall) & kSide_S))
+        {
+            sides &= ~kSide_S;
+        }
+        if (tileX < tileMap.columnCount()-1 &&
+            !(cornerSides(readMap.at(tileY, tileX+1).wall) & kSide_E))
+        {
+            sides &= ~kSide_E;
+        }
+
+        thisTile.wall = tiles.corners[sides];
+        tileMap.set(tileY, tileX, thisTile);
+    }
+
+    uint8_t Builder::floorClassId(TileHandle floor) const
+    {
+        return _floorClassIds[floor < _floorClassIds.size() ? floor : 0];
+    }
+
+    bool Builder::tileWallsEqual(TileHandle wall, uint16_t roleFlags, uint8_t classId) const
+    {
+        const TileTemplate& wallTemplate = _tileTemplates.tile(wall);
+        return wallTemplate.classId == classId &&
+              (wallTemplate.roleFlags & roleFlags)==roleFlags;
+    }
+
+    //  the role of a wall tile, given its sides bordering a different class
+    //  of floor.
+    //
+    uint16_t Builder::wallRoleFlags(uint32_t wallSides)
+    {
         uint16_t wallRoleFlags = 0;
 
-        if (wallMask)
+        if (wallSides)
         {
-            if (wallMask & kTileDirection_W)
+            if (wallSides & kSide_W)
             {
-                if (wallMask & kTileDirection_N)
+                if (wallSides & kSide_N)
                     wallRoleFlags |= kTileDirection_NW;
-                else if (wallMask & kTileDirection_S)
+                else if (wallSides & kSide_S)
                     wallRoleFlags |= kTileDirection_SW;
                 else
                     wallRoleFlags |= kTileDirection_W;
             }
-            if (!wallRoleFlags && (wallMask & kTileDirection_N))
+            if (!wallRoleFlags && (wallSides & kSide_N))
             {
                 //  we've already evaluated for West, so only need to eval East
-                if (wallMask & kTileDirection_E)
+                if (wallSides & kSide_E)
                     wallRoleFlags |= kTileDirection_NE;
                 else
                     wallRoleFlags |= kTileDirection_N;
             }
-            if (!wallRoleFlags && (wallMask & kTileDirection_E))
+            if (!wallRoleFlags && (wallSides & kSide_E))
             {
                 //  we've already evaluated North, so only care about South
-                if (wallMask & kTileDirection_S)
+                if (wallSides & kSide_S)
                     wallRoleFlags |= kTileDirection_SE;
                 else
                     wallRoleFlags |= kTileDirection_E;
             }
-            if (!wallRoleFlags && (wallMask & kTileDirection_S))
+            if (!wallRoleFlags && (wallSides & kSide_S))
             {
                 //  we've already evaluated East and West, so...
                 wallRoleFlags |= kTileDirection_S;
@@ -352,122 +506,35 @@ namespace cinekine { namespace overview {
 
             wallRoleFlags |= kTileRole_Wall;
         }
-
-        TileHandle wallTileHandle =
-            _tileTemplates.tileHandleFromDescriptor(brush.tileCategoryId,
-                                                brush.tileClassId,
-                                                wallRoleFlags);
-
-        Tile& thisTile = tileMap.at(tileY, tileX);
-        thisTile.wall = wallTileHandle;
+        return wallRoleFlags;
     }
 
-    bool Builder::tileFloorsClassIdEqual(const Tile& tile, uint8_t thisClassId) const
-    {
-        const TileTemplate& floorTemplate = _tileTemplates.tile(tile.floor);
-        return floorTemplate.classId == thisClassId;
-    }
-
-    void Builder::paintTileWallCorners(Tilemap& tileMap, uint32_t tileY, uint32_t tileX,
-                            const TileBrush& brush)
+    //  the role of a corner tile, given its sides bordering walls that run
+    //  toward it.
+    //
+    uint16_t Builder::cornerRoleFlags(uint32_t cornerSides)
     {
-        uint16_t cornerMask = kTileDirection_N | kTileDirection_W |
-                    kTileDirection_S | kTileDirection_E;
-
-        Tile& thisTile = tileMap.at(tileY, tileX);
-        if (thisTile.wall)
-        {
-            // this tile already has a wall - no need to run tests
-            return;
-        }
-
-        //printf("at (%u,%u) => ", tileX, tileY);
-
         uint16_t wallRoleFlags = 0;
 
-        if (tileY > 0)
-        {
-            const Tile& north = tileMap.at(tileY-1, tileX);
-            //printf("north:[%u,%u], ", north.floor, north.wall);
-            if (!tileWallsEqual(north, kTileDirection_W, brush.tileClassId) &&
-                !tileWallsEqual(north, kTileDirection_E, brush.tileClassId) &&
-                !tileWallsEqual(north, kTileDirection_NW, brush.tileClassId) &&
-                !tileWallsEqual(north, kTileDirection_NE, brush.tileClassId))
-            {
-                cornerMask &= ~(kTileDirection_N);
-            }
-        }
-        if (tileX > 0)
-        {
-            const Tile& west = tileMap.at(tileY, tileX-1);
-            //printf("west:[%u,%u], ", west.floor, west.wall);
-            if (!tileWallsEqual(west, kTileDirection_N, brush.tileClassId) &&
-                !tileWallsEqual(west, kTileDirection_S, brush.tileClassId) &&
-                !tileWallsEqual(west, kTileDirection_NW, brush.tileClassId) &&
-                !tileWallsEqual(west, kTileDirection_SW, brush.tileClassId))
-            {
-                cornerMask &= ~(kTileDirection_W);
-            }
-        }
-        if (tileY < tileMap.rowCount()-1)
-        {
-            const Tile& south = tileMap.at(tileY+1, tileX);
-            //printf("south:[%u,%u], ", south.floor, south.wall);
-            if (!tileWallsEqual(south, kTileDirection_W, brush.tileClassId) &&
-                !tileWallsEqual(south, kTileDirection_E, brush.tileClassId) &&
-                !tileWallsEqual(south, kTileDirection_SW, brush.tileClassId) &&
-                !tileWallsEqual(south, kTileDirection_SE, brush.tileClassId))
-            {
-                cornerMask &= ~(kTileDirection_S);
-            }
-        }
-        if (tileX < tileMap.columnCount()-1)
-        {
-            const Tile& east = tileMap.at(tileY, tileX+1);
-            //printf("east:[%u,%u], ", east.floor, east.wall);
-            if (!tileWallsEqual(east, kTileDirection_S, brush.tileClassId) &&
-                !tileWallsEqual(east, kTileDirection_N, brush.tileClassId) &&
-                !tileWallsEqual(east, kTileDirection_NE, brush.tileClassId) &&
-                !tileWallsEqual(east, kTileDirection_SE, brush.tileClassId))
-            {
-                cornerMask &= ~(kTileDirection_E);
-            }
-        }
-
-        if (cornerMask & kTileDirection_W)
+        if (cornerSides & kSide_W)
         {
-            if (cornerMask & kTileDirection_N)
+            if (cornerSides & kSide_N)
                 wallRoleFlags |= kTileDirection_NW;
-            else  if (cornerMask & kTileDirection_S)
+            else  if (cornerSides & kSide_S)
                 wallRoleFlags |= kTileDirection_SW;
         }
-        if (!wallRoleFlags && (cornerMask & kTileDirection_N))
+        if (!wallRoleFlags && (cornerSides & kSide_N))
         {
-            if (cornerMask & kTileDirection_E)
+            if (cornerSides & kSide_E)
                 wallRoleFlags |= kTileDirection_NE;
         }
-        if (!wallRoleFlags && (cornerMask & kTileDirection_E))
+        if (!wallRoleFlags && (cornerSides & kSide_E))
         {
-            if (cornerMask & kTileDirection_S)
+            if (cornerSides & kSide_S)
                 wallRoleFlags |= kTileDirection_SE;
         }
-        //printf("cornerFlags, wallRoleFlags (%04x,%04x)\n",
-        //    cornerMask, wallRoleFlags);
         wallRoleFlags |= (kTileRole_Wall+kTileRole_Corner);
-
-        TileHandle wallTileHandle =
-            _tileTemplates.tileHandleFromDescriptor(brush.tileCategoryId,
-                                                brush.tileClassId,
-                                                wallRoleFlags);
-
-        thisTile.wall = wallTileHandle;
-    }
-
-    bool Builder::tileWallsEqual(const Tile& tile, uint16_t roleFlags, uint8_t classId) const
-    {
-        const TileTemplate& wallTemplate = _tileTemplates.tile(tile.wall);
-        return wallTemplate.classId == classId &&
-              (wallTemplate.roleFlags & roleFlags)==roleFlags;
+        return wallRoleFlags;
     }
 
 } /* namespace overview */ } /* namespace cinekine */
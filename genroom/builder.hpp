@@ -111,16 +111,47 @@ namespace cinekine { namespace overview {
                     const MapPoint& p0,
                     const MapPoint& p1);
         void paintBoxOntoMap(const TileBrush& brush, const Box& box);
+        //  Tiles selected by a mask of a tile's four sides (kSide_N, etc.)
+        enum
+        {
+            kSide_N = 0x1,
+            kSide_E = 0x2,
+            kSide_S = 0x4,
+            kSide_W = 0x8,
+            kSideMaskCount = 16
+        };
+        //  A brush's autotiling tables, built from the TileDatabase the
+        //  first time the brush is painted.
+        struct BrushTiles
+        {
+            TileBrush brush;
+            TileHandle floor;
+            //  wall tiles by the sides not bordering floor of the same class
+            TileHandle walls[kSideMaskCount];
+            //  corner tiles by the sides bordering one of the brush's walls
+            //  that runs toward the tile
+            TileHandle corners[kSideMaskCount];
+            //  for each wall tile handle, the sides it counts as a corner
+            //  neighbour from
+            std::vector<uint8_t> cornerSides;
+        };
+
+        const BrushTiles& brushTiles(const TileBrush& brush);
         void paintTileWalls(Tilemap& tileMap, uint32_t tileY, uint32_t tileX,
-                    const TileBrush& brush);
+                    const BrushTiles& tiles);
         void paintTileWallCorners(Tilemap& tileMap, uint32_t tileY, uint32_t tileX,
-                    const TileBrush& brush);
-        bool tileFloorsClassIdEqual(const Tile& tile, uint8_t thisClassId) const;
-        bool tileWallsEqual(const Tile& tile, uint16_t roleFlags, uint8_t classId) const;
+                    const BrushTiles& tiles);
+        uint8_t floorClassId(TileHandle floor) const;
+        bool tileWallsEqual(TileHandle wall, uint16_t roleFlags, uint8_t classId) const;
+        static uint16_t wallRoleFlags(uint32_t wallSides);
+        static uint16_t cornerRoleFlags(uint32_t cornerSides);
 
     private:
         Map& _map;
         const TileDatabase& _tileTemplates;
+        //  the class of each floor tile handle, shared by all brushes
+        std::vector<uint8_t> _floorClassIds;
+        std::vector<BrushTiles> _brushTiles;
 
         std::vector<Region> _regions;
         std::vector<Segment> _segments;
@@ -0,0 +1,543 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef CINEK_OVERVIEW_CHUNKEDGRID_HPP
+#define CINEK_OVERVIEW_CHUNKEDGRID_HPP
+
+#include "grid.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace cinekine {
+    namespace overview {
+
+/**
+ * @class ChunkedGridRowIterator chunkedgrid.hpp "cinek/overview/chunkedgrid.hpp"
+ * @brief Walks a row of a ChunkedGrid, value by value.  Used like the
+ * pointers of a row-major Grid's row strips.
+ */
+template<typename GridType, typename Value>
+class ChunkedGridRowIterator :
+    public std::iterator<std::random_access_iterator_tag, Value>
+{
+public:
+    ChunkedGridRowIterator() : _grid(nullptr), _row(0), _col(0) {}
+    ChunkedGridRowIterator(GridType* grid, uint32_t row, uint32_t col) :
+        _grid(grid), _row(row), _col(col) {}
+
+    /** @return The column the iterator points at. */
+    uint32_t column() const { return _col; }
+
+    Value& operator*() const { return _grid->at(_row, _col); }
+    Value* operator->() const { return &operator*(); }
+    Value& operator[](ptrdiff_t offset) const { return *(*this + offset); }
+
+    ChunkedGridRowIterator& operator++() { ++_col; return *this; }
+    ChunkedGridRowIterator operator++(int) {
+        ChunkedGridRowIterator tmp(*this);
+        ++_col;
+        return tmp;
+    }
+    ChunkedGridRowIterator& operator--() { --_col; return *this; }
+    ChunkedGridRowIterator operator--(int) {
+        ChunkedGridRowIterator tmp(*this);
+        --_col;
+        return tmp;
+    }
+    ChunkedGridRowIterator& operator+=(ptrdiff_t offset) {
+        _col += (int32_t)offset;
+        return *this;
+    }
+    ChunkedGridRowIterator& operator-=(ptrdiff_t offset) {
+        _col -= (int32_t)offset;
+        return *this;
+    }
+    ChunkedGridRowIterator operator+(ptrdiff_t offset) const {
+        return ChunkedGridRowIterator(_grid, _row, _col + (int32_t)offset);
+    }
+    ChunkedGridRowIterator operator-(ptrdiff_t offset) const {
+        return ChunkedGridRowIterator(_grid, _row, _col - (int32_t)offset);
+    }
+    ptrdiff_t operator-(const ChunkedGridRowIterator& rhs) const {
+        return (ptrdiff_t)_col - (ptrdiff_t)rhs._col;
+    }
+
+    bool operator==(const ChunkedGridRowIterator& rhs) const {
+        return _grid == rhs._grid && _row == rhs._row && _col == rhs._col;
+    }
+    bool operator!=(const ChunkedGridRowIterator& rhs) const { return !(*this == rhs); }
+    bool operator<(const ChunkedGridRowIterator& rhs) const { return _col < rhs._col; }
+    bool operator<=(const ChunkedGridRowIterator& rhs) const { return _col <= rhs._col; }
+    bool operator>(const ChunkedGridRowIterator& rhs) const { return _col > rhs._col; }
+    bool operator>=(const ChunkedGridRowIterator& rhs) const { return _col >= rhs._col; }
+
+    /** Converts a non-const iterator to its const equivalent. */
+    operator ChunkedGridRowIterator<const GridType, const Value>() const {
+        return ChunkedGridRowIterator<const GridType, const Value>(_grid, _row, _col);
+    }
+
+private:
+    GridType* _grid;
+    uint32_t _row;
+    uint32_t _col;
+};
+
+/**
+ * @class ChunkedGrid chunkedgrid.hpp "cinek/overview/chunkedgrid.hpp"
+ * @brief A sparse 2D grid of data of type T, allocated in square chunks.
+ *
+ * The grid is divided into ChunkSize x ChunkSize chunks (row-major within
+ * each chunk.)  A chunk without storage holds a single uniform value -
+ * initially the grid's default value - that's returned for every read within
+ * the chunk.  Storage is allocated by the first write into a chunk that
+ * would change it, so memory follows the parts of the grid that have been
+ * carved up rather than the grid's size.
+ *
+ * Non-const access (at, atRow and the row strips of a GridContainer) is
+ * treated as a write, allocating the chunk accessed - read through a const
+ * grid to avoid this.  fillWithValue sets whole chunks to a uniform value
+ * without allocating them, and compact releases chunks whose contents have
+ * returned to a uniform value.
+ *
+ * Like Grid, values are stored without being constructed, so Value must be
+ * a trivially copyable type.  Values are compared bytewise.
+ */
+template<typename Value, uint32_t ChunkSize=64>
+class ChunkedGrid
+{
+    static_assert(ChunkSize && !(ChunkSize & (ChunkSize-1)),
+                  "ChunkSize must be a power of two");
+public:
+    /** Iterates the values of a row strip. */
+    typedef ChunkedGridRowIterator<ChunkedGrid, Value> row_iterator;
+    /** Const version of a row_iterator. */
+    typedef ChunkedGridRowIterator<const ChunkedGrid, const Value> const_row_iterator;
+    /**
+     *  Defines a start and end point for T items in a row.  The end iterator
+     *  points past the last item in the strip.
+     */
+    typedef std::pair<row_iterator, row_iterator> row_strip;
+    /** Const version of a row_strip */
+    typedef std::pair<const_row_iterator, const_row_iterator> const_row_strip;
+
+    ChunkedGrid(const ChunkedGrid& ) = delete;
+    ChunkedGrid& operator=(const ChunkedGrid& ) = delete;
+
+    /**
+     * Empty grid constructor.
+     */
+    ChunkedGrid();
+    /**
+     *  Constructor that creates a grid with specified dimensions.  No chunk
+     *  storage is allocated.
+     *
+     *  @param rowCount     Number of rows in the grid.
+     *  @param columnCount  Number of columns in the grid.
+     *  @param defaultValue The value of every item until it's written.
+     */
+    ChunkedGrid(uint32_t rowCount, uint32_t columnCount,
+                const Value& defaultValue=Value());
+    /**
+     *  Move constructor.
+     *  @param grid The grid being moved into this object.
+     */
+    ChunkedGrid(ChunkedGrid&& grid) noexcept;
+    /**
+     * Destructor.
+     */
+    ~ChunkedGrid();
+    /**
+     * Assignment move operator.
+     */
+    ChunkedGrid& operator=(ChunkedGrid&& grid) noexcept;
+
+    /** @return Number of rows in grid. */
+    uint32_t rowCount() const { return _rowCount; }
+    /** @return Number of columns in grid */
+    uint32_t columnCount() const { return _colCount; }
+    /** @return Number of chunks with storage allocated. */
+    size_t allocatedChunkCount() const { return _allocatedChunkCount; }
+    /** @return Bytes of chunk storage allocated. */
+    size_t allocatedBytes() const {
+        return _allocatedChunkCount * ChunkSize * ChunkSize * sizeof(Value);
+    }
+    /**
+     * Gets a const reference of the value at the specified row, column.
+     * Doesn't allocate - the value of an unallocated chunk is shared by all
+     * of its items.
+     * @param  row The row [0, rowCount-1]
+     * @param  col The column [0, columnCount-1]
+     * @return     A reference of the value at row,col.
+     */
+    const Value& at(uint32_t row, uint32_t col) const;
+    /**
+     * Gets a reference of the value at the specified row, column, allocating
+     * its chunk if needed.
+     * @param  row The row [0, rowCount-1]
+     * @param  col The column [0, columnCount-1]
+     * @return     A reference of the value at row,col.
+     */
+    Value& at(uint32_t row, uint32_t col);
+    /**
+     * Sets the value at the specified row, column - only allocating its
+     * chunk if the value differs from the chunk's uniform value.
+     * @param  row      The row [0, rowCount-1]
+     * @param  col      The column [0, columnCount-1]
+     * @param  value    The value to set
+     */
+    void set(uint32_t row, uint32_t col, const Value& value);
+    /**
+     * Returns a strip of the data row in the grid.
+     * @param  row      Row index in grid [0, rowCount()]
+     * @param  col      Column offset from start of row.
+     * @param  length   Number of columns in row to use.  If UINT32_MAX, the strip
+     *                  will run to the end of the row.
+     * @return          A row strip iterator pair.  If the row or column
+     *                  parameter lie out of the grid's range, returns a
+     *                  null row_strip.
+     */
+    row_strip atRow(uint32_t row, uint32_t col, uint32_t length=UINT32_MAX);
+    /**
+     * Returns a const strip of the data row in the grid.
+     * @param  row      Row index in grid [0, rowCount()]
+     * @param  col      Column offset from start of row.
+     * @param  length   Number of columns in row to use.  If UINT32_MAX, the strip
+     *                  will run to the end of the row.
+     * @return          A row strip iterator pair.  If the row or column
+     *                  parameter lie out of the grid's range, returns a
+     *                  null const_row_strip.
+     */
+    const_row_strip atRow(uint32_t row, uint32_t col, uint32_t length=UINT32_MAX) const;
+    /**
+     * Fills a region within the grid with a specific value.  Chunks covered
+     * entirely by the region are released and set to the value.
+     * @param  value    The value to set
+     * @param  row      Row index in grid [0, rowCount()]
+     * @param  col      Column offset from start of row.
+     * @param  rows     Number of rows to fill
+     * @param  cols     Number of columns to fill
+     */
+    void fillWithValue(Value value,
+                      uint32_t row, uint32_t col, uint32_t rows, uint32_t cols);
+    /**
+     * Releases the storage of every chunk whose items all hold the same
+     * value.
+     * @return          The number of chunks released.
+     */
+    size_t compact();
+
+private:
+    struct Chunk
+    {
+        Value* data;
+        Value uniform;
+    };
+
+    Chunk& chunkAt(uint32_t row, uint32_t col);
+    const Chunk& chunkAt(uint32_t row, uint32_t col) const;
+    Value* allocateChunk(Chunk& chunk);
+    void releaseChunk(Chunk& chunk, const Value& uniform);
+    bool chunkUniform(uint32_t chunkRow, uint32_t chunkCol) const;
+    void releaseAll();
+    static bool valuesEqual(const Value& a, const Value& b) {
+        return !memcmp(&a, &b, sizeof(Value));
+    }
+    static uint32_t offsetInChunk(uint32_t row, uint32_t col) {
+        return (row % ChunkSize) * ChunkSize + col % ChunkSize;
+    }
+
+    std::vector<Chunk> _chunks;
+    uint32_t _rowCount;
+    uint32_t _colCount;
+    uint32_t _chunksPerRow;
+    size_t _allocatedChunkCount;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<typename Value, uint32_t ChunkSize>
+ChunkedGrid<Value, ChunkSize>::ChunkedGrid() :
+    _rowCount(0),
+    _colCount(0),
+    _chunksPerRow(0),
+    _allocatedChunkCount(0)
+{
+}
+
+template<typename Value, uint32_t ChunkSize>
+ChunkedGrid<Value, ChunkSize>::ChunkedGrid(uint32_t rowCount, uint32_t columnCount,
+                                           const Value& defaultValue) :
+    _rowCount(rowCount),
+    _colCount(columnCount),
+    _chunksPerRow((columnCount + ChunkSize-1) / ChunkSize),
+    _allocatedChunkCount(0)
+{
+    Chunk chunk;
+    chunk.data = nullptr;
+    chunk.uniform = defaultValue;
+    _chunks.resize((size_t)_chunksPerRow * ((rowCount + ChunkSize-1) / ChunkSize),
+                   chunk);
+}
+
+template<typename Value, uint32_t ChunkSize>
+ChunkedGrid<Value, ChunkSize>::~ChunkedGrid()
+{
+    releaseAll();
+}
+
+template<typename Value, uint32_t ChunkSize>
+ChunkedGrid<Value, ChunkSize>::ChunkedGrid(ChunkedGrid&& grid) noexcept :
+    _chunks(std::move(grid._chunks)),
+    _rowCount(grid._rowCount),
+    _colCount(grid._colCount),
+    _chunksPerRow(grid._chunksPerRow),
+    _allocatedChunkCount(grid._allocatedChunkCount)
+{
+    grid._chunks.clear();
+    grid._rowCount = grid._colCount = grid._chunksPerRow = 0;
+    grid._allocatedChunkCount = 0;
+}
+
+template<typename Value, uint32_t ChunkSize>
+ChunkedGrid<Value, ChunkSize>&
+    ChunkedGrid<Value, ChunkSize>::operator=(ChunkedGrid&& grid) noexcept
+{
+    releaseAll();
+    _chunks = std::move(grid._chunks);
+    _rowCount = grid._rowCount;
+    _colCount = grid._colCount;
+    _chunksPerRow = grid._chunksPerRow;
+    _allocatedChunkCount = grid._allocatedChunkCount;
+
+    grid._chunks.clear();
+    grid._rowCount = grid._colCount = grid._chunksPerRow = 0;
+    grid._allocatedChunkCount = 0;
+
+    return *this;
+}
+
+template<typename Value, uint32_t ChunkSize>
+void ChunkedGrid<Value, ChunkSize>::releaseAll()
+{
+    for (auto& chunk : _chunks)
+    {
+        if (chunk.data != nullptr)
+        {
+            free(chunk.data);
+            chunk.data = nullptr;
+        }
+    }
+    _allocatedChunkCount = 0;
+}
+
+template<typename Value, uint32_t ChunkSize>
+auto ChunkedGrid<Value, ChunkSize>::chunkAt(uint32_t row, uint32_t col) const
+    -> const Chunk&
+{
+    return _chunks[(size_t)(row / ChunkSize) * _chunksPerRow + col / ChunkSize];
+}
+
+template<typename Value, uint32_t ChunkSize>
+auto ChunkedGrid<Value, ChunkSize>::chunkAt(uint32_t row, uint32_t col) -> Chunk&
+{
+    return _chunks[(size_t)(row / ChunkSize) * _chunksPerRow + col / ChunkSize];
+}
+
+//  New chunk storage starts out filled with the chunk's uniform value.
+//
+template<typename Value, uint32_t ChunkSize>
+Value* ChunkedGrid<Value, ChunkSize>::allocateChunk(Chunk& chunk)
+{
+    Value* data = (Value*)malloc(ChunkSize * ChunkSize * sizeof(Value));
+    std::fill(data, data + ChunkSize * ChunkSize, chunk.uniform);
+    chunk.data = data;
+    ++_allocatedChunkCount;
+    return data;
+}
+
+template<typename Value, uint32_t ChunkSize>
+void ChunkedGrid<Value, ChunkSize>::releaseChunk(Chunk& chunk, const Value& uniform)
+{
+    if (chunk.data != nullptr)
+    {
+        free(chunk.data);
+        chunk.data = nullptr;
+        --_allocatedChunkCount;
+    }
+    chunk.uniform = uniform;
+}
+
+template<typename Value, uint32_t ChunkSize>
+const Value& ChunkedGrid<Value, ChunkSize>::at(uint32_t row, uint32_t col) const
+{
+    const Chunk& chunk = chunkAt(row, col);
+    if (chunk.data == nullptr)
+        return chunk.uniform;
+    return chunk.data[offsetInChunk(row, col)];
+}
+
+template<typename Value, uint32_t ChunkSize>
+Value& ChunkedGrid<Value, ChunkSize>::at(uint32_t row, uint32_t col)
+{
+    Chunk& chunk = chunkAt(row, col);
+    Value* data = chunk.data != nullptr ? chunk.data : allocateChunk(chunk);
+    return data[offsetInChunk(row, col)];
+}
+
+template<typename Value, uint32_t ChunkSize>
+void ChunkedGrid<Value, ChunkSize>::set(uint32_t row, uint32_t col, const Value& value)
+{
+    Chunk& chunk = chunkAt(row, col);
+    if (chunk.data == nullptr)
+    {
+        if (valuesEqual(chunk.uniform, value))
+            return;
+        allocateChunk(chunk);
+    }
+    chunk.data[offsetInChunk(row, col)] = value;
+}
+
+template<typename Value, uint32_t ChunkSize>
+typename ChunkedGrid<Value, ChunkSize>::const_row_strip
+    ChunkedGrid<Value, ChunkSize>::atRow(uint32_t row, uint32_t col, uint32_t length) const
+{
+    if (row >= _rowCount || col >= _colCount)
+        return const_row_strip();
+    if (length == UINT32_MAX)
+        length = _colCount - col;
+    uint32_t endCol = std::min(col+length, _colCount);
+    return std::make_pair(const_row_iterator(this, row, col),
+                          const_row_iterator(this, row, endCol));
+}
+
+template<typename Value, uint32_t ChunkSize>
+typename ChunkedGrid<Value, ChunkSize>::row_strip
+    ChunkedGrid<Value, ChunkSize>::atRow(uint32_t row, uint32_t col, uint32_t length)
+{
+    if (row >= _rowCount || col >= _colCount)
+        return row_strip();
+    if (length == UINT32_MAX)
+        length = _colCount - col;
+    uint32_t endCol = std::min(col+length, _colCount);
+    return std::make_pair(row_iterator(this, row, col),
+                          row_iterator(this, row, endCol));
+}
+
+//  Works a chunk at a time - a chunk entirely within the region doesn't need
+//  storage at all, and a partly covered chunk only needs storage if the
+//  value differs from its uniform value.
+//
+template<typename Value, uint32_t ChunkSize>
+void ChunkedGrid<Value, ChunkSize>::fillWithValue(Value value,
+                        uint32_t row, uint32_t col,
+                        uint32_t rows, uint32_t cols)
+{
+    if (row >= _rowCount || col >= _colCount)
+        return;
+    uint32_t endRow = row + std::min(rows, _rowCount - row);
+    uint32_t endCol = col + std::min(cols, _colCount - col);
+
+    for (uint32_t chunkRow = row / ChunkSize; chunkRow * ChunkSize < endRow; ++chunkRow)
+    {
+        uint32_t chunkTop = chunkRow * ChunkSize;
+        uint32_t chunkBottom = std::min(chunkTop + ChunkSize, _rowCount);
+        uint32_t fillTop = std::max(row, chunkTop);
+        uint32_t fillBottom = std::min(endRow, chunkBottom);
+
+        for (uint32_t chunkCol = col / ChunkSize; chunkCol * ChunkSize < endCol; ++chunkCol)
+        {
+            uint32_t chunkLeft = chunkCol * ChunkSize;
+            uint32_t chunkRight = std::min(chunkLeft + ChunkSize, _colCount);
+            uint32_t fillLeft = std::max(col, chunkLeft);
+            uint32_t fillRight = std::min(endCol, chunkRight);
+
+            Chunk& chunk = _chunks[(size_t)chunkRow * _chunksPerRow + chunkCol];
+            if (fillTop == chunkTop && fillBottom == chunkBottom &&
+                fillLeft == chunkLeft && fillRight == chunkRight)
+            {
+                releaseChunk(chunk, value);
+                continue;
+            }
+            if (chunk.data == nullptr)
+            {
+                if (valuesEqual(chunk.uniform, value))
+                    continue;
+                allocateChunk(chunk);
+            }
+            for (uint32_t r = fillTop; r < fillBottom; ++r)
+            {
+                Value* rowData = chunk.data + offsetInChunk(r, fillLeft);
+                std::fill(rowData, rowData + (fillRight - fillLeft), value);
+            }
+        }
+    }
+}
+
+//  Only the items within the grid's bounds count - the parts of edge chunks
+//  past the bounds are never read.
+//
+template<typename Value, uint32_t ChunkSize>
+bool ChunkedGrid<Value, ChunkSize>::chunkUniform(uint32_t chunkRow, uint32_t chunkCol) const
+{
+    const Chunk& chunk = _chunks[(size_t)chunkRow * _chunksPerRow + chunkCol];
+    uint32_t rows = std::min(ChunkSize, _rowCount - chunkRow * ChunkSize);
+    uint32_t cols = std::min(ChunkSize, _colCount - chunkCol * ChunkSize);
+    const Value& first = chunk.data[0];
+    for (uint32_t r = 0; r < rows; ++r)
+    {
+        const Value* rowData = chunk.data + r * ChunkSize;
+        for (uint32_t c = 0; c < cols; ++c)
+        {
+            if (!valuesEqual(rowData[c], first))
+                return false;
+        }
+    }
+    return true;
+}
+
+template<typename Value, uint32_t ChunkSize>
+size_t ChunkedGrid<Value, ChunkSize>::compact()
+{
+    size_t released = 0;
+    for (uint32_t chunkRow = 0; chunkRow * ChunkSize < _rowCount; ++chunkRow)
+    {
+        for (uint32_t chunkCol = 0; chunkCol < _chunksPerRow; ++chunkCol)
+        {
+            Chunk& chunk = _chunks[(size_t)chunkRow * _chunksPerRow + chunkCol];
+            if (chunk.data == nullptr || !chunkUniform(chunkRow, chunkCol))
+                continue;
+            Value uniform = chunk.data[0];
+            releaseChunk(chunk, uniform);
+            ++released;
+        }
+    }
+    return released;
+}
+
+    } /* overview */
+} /* cinekine */
+
+#endif
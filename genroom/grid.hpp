@@ -16,26 +16,242 @@
 
 #include <iterator>
 #include <algorithm>
+#include <type_traits>
+#include <utility>
 
 namespace cinekine {
     namespace overview {
 
+/**
+ * @class RowMajorLayout grid.hpp "cinek/overview/grid.hpp"
+ * @brief The default Grid storage layout, storing each row after the other.
+ *
+ * A storage layout maps a row and column to an index into the grid's
+ * storage.  Layouts that keep each row contiguous (kContiguousRows) let a
+ * Grid hand out row strips as plain pointers.
+ */
+class RowMajorLayout
+{
+public:
+    static const bool kContiguousRows = true;
+
+    RowMajorLayout() : _colCount(0), _size(0) {}
+    RowMajorLayout(uint32_t rowCount, uint32_t columnCount) :
+        _colCount(columnCount), _size((size_t)rowCount * columnCount) {}
+
+    /** @return Number of values in the layout's storage. */
+    size_t size() const { return _size; }
+    /** @return The storage index of the value at row, col. */
+    size_t index(uint32_t row, uint32_t col) const {
+        return (size_t)_colCount * row + col;
+    }
+
+private:
+    uint32_t _colCount;
+    size_t _size;
+};
+
+/**
+ * @class TiledLayout grid.hpp "cinek/overview/grid.hpp"
+ * @brief Stores a Grid as square tiles of TileSize x TileSize values.
+ *
+ * Each tile is stored row-major, and the tiles are stored row-major in turn,
+ * so the neighbours above and below a value usually lie in the same tile.
+ * A 16x16 tile of 4 byte values is 1 KB - small enough that a kernel
+ * reading a value's neighbours touches a handful of cache lines instead of
+ * three widely separated rows.  The grid's dimensions are padded to a
+ * multiple of the tile size.
+ */
+template<uint32_t TileSize>
+class TiledLayout
+{
+    static_assert(TileSize && !(TileSize & (TileSize-1)),
+                  "TileSize must be a power of two");
+public:
+    static const bool kContiguousRows = false;
+
+    TiledLayout() : _tilesPerRow(0), _size(0) {}
+    TiledLayout(uint32_t rowCount, uint32_t columnCount) :
+        _tilesPerRow((columnCount + TileSize-1) / TileSize),
+        _size((size_t)_tilesPerRow * ((rowCount + TileSize-1) / TileSize) *
+              TileSize * TileSize) {}
+
+    /** @return Number of values in the layout's storage. */
+    size_t size() const { return _size; }
+    /** @return The storage index of the value at row, col. */
+    size_t index(uint32_t row, uint32_t col) const {
+        size_t tile = (size_t)(row / TileSize) * _tilesPerRow + col / TileSize;
+        return tile * TileSize * TileSize +
+               (row % TileSize) * TileSize + col % TileSize;
+    }
+
+private:
+    uint32_t _tilesPerRow;
+    size_t _size;
+};
+
+/**
+ * @class MortonLayout grid.hpp "cinek/overview/grid.hpp"
+ * @brief Stores a Grid in Morton (Z) order.
+ *
+ * Interleaves the bits of the row and column, so values close in both
+ * dimensions stay close in memory at every scale.  The dimensions are
+ * padded to powers of two - where they differ, the longer dimension's
+ * upper bits are stored above the interleaved bits, making a row of
+ * Morton ordered squares.
+ */
+class MortonLayout
+{
+public:
+    static const bool kContiguousRows = false;
+
+    MortonLayout() : _interleavedBits(0), _rowBits(0), _colBits(0) {}
+    MortonLayout(uint32_t rowCount, uint32_t columnCount) :
+        _rowBits(bitsFor(rowCount)),
+        _colBits(bitsFor(columnCount))
+    {
+        _interleavedBits = std::min(_rowBits, _colBits);
+    }
+
+    /** @return Number of values in the layout's storage. */
+    size_t size() const { return (size_t)1 << (_rowBits + _colBits); }
+    /** @return The storage index of the value at row, col. */
+    size_t index(uint32_t row, uint32_t col) const {
+        const uint32_t lowMask = (1u << _interleavedBits) - 1;
+        size_t index = spreadBits(col & lowMask) | (spreadBits(row & lowMask) << 1);
+        //  only one of these is nonzero
+        size_t high = (size_t)(row >> _interleavedBits) | (col >> _interleavedBits);
+        return index | (high << (2 * _interleavedBits));
+    }
+
+private:
+    static uint32_t bitsFor(uint32_t count) {
+        uint32_t bits = 0;
+        while (((size_t)1 << bits) < count)
+            ++bits;
+        return bits;
+    }
+    //  spaces the lower 32 bits of value out to the even bits of the result
+    static size_t spreadBits(uint64_t value) {
+        value = (value | (value << 16)) & 0x0000ffff0000ffffULL;
+        value = (value | (value << 8)) & 0x00ff00ff00ff00ffULL;
+        value = (value | (value << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        value = (value | (value << 2)) & 0x3333333333333333ULL;
+        value = (value | (value << 1)) & 0x5555555555555555ULL;
+        return (size_t)value;
+    }
+
+    uint32_t _interleavedBits;
+    uint32_t _rowBits;
+    uint32_t _colBits;
+};
+
+/**
+ * @class GridRowIterator grid.hpp "cinek/overview/grid.hpp"
+ * @brief Walks a row of a Grid whose layout doesn't store rows
+ * contiguously.  Behaves like the pointers used for row-major grids, so
+ * row strips from any layout are iterated the same way.
+ */
+template<typename Value, typename Layout>
+class GridRowIterator :
+    public std::iterator<std::random_access_iterator_tag, Value>
+{
+public:
+    GridRowIterator() : _data(nullptr), _layout(nullptr), _row(0), _col(0) {}
+    GridRowIterator(Value* data, const Layout* layout, uint32_t row, uint32_t col) :
+        _data(data), _layout(layout), _row(row), _col(col) {}
+
+    /** @return The column the iterator points at. */
+    uint32_t column() const { return _col; }
+
+    Value& operator*() const { return _data[_layout->index(_row, _col)]; }
+    Value* operator->() const { return &operator*(); }
+    Value& operator[](ptrdiff_t offset) const { return *(*this + offset); }
+
+    GridRowIterator& operator++() { ++_col; return *this; }
+    GridRowIterator operator++(int) { GridRowIterator tmp(*this); ++_col; return tmp; }
+    GridRowIterator& operator--() { --_col; return *this; }
+    GridRowIterator operator--(int) { GridRowIterator tmp(*this); --_col; return tmp; }
+    GridRowIterator& operator+=(ptrdiff_t offset) { _col += (int32_t)offset; return *this; }
+    GridRowIterator& operator-=(ptrdiff_t offset) { _col -= (int32_t)offset; return *this; }
+    GridRowIterator operator+(ptrdiff_t offset) const {
+        return GridRowIterator(_data, _layout, _row, _col + (int32_t)offset);
+    }
+    GridRowIterator operator-(ptrdiff_t offset) const {
+        return GridRowIterator(_data, _layout, _row, _col - (int32_t)offset);
+    }
+    ptrdiff_t operator-(const GridRowIterator& rhs) const {
+        return (ptrdiff_t)_col - (ptrdiff_t)rhs._col;
+    }
+
+    bool operator==(const GridRowIterator& rhs) const {
+        return _data == rhs._data && _row == rhs._row && _col == rhs._col;
+    }
+    bool operator!=(const GridRowIterator& rhs) const { return !(*this == rhs); }
+    bool operator<(const GridRowIterator& rhs) const { return _col < rhs._col; }
+    bool operator<=(const GridRowIterator& rhs) const { return _col <= rhs._col; }
+    bool operator>(const GridRowIterator& rhs) const { return _col > rhs._col; }
+    bool operator>=(const GridRowIterator& rhs) const { return _col >= rhs._col; }
+
+    /** Converts a non-const iterator to its const equivalent. */
+    operator GridRowIterator<const Value, Layout>() const {
+        return GridRowIterator<const Value, Layout>(_data, _layout, _row, _col);
+    }
+
+private:
+    Value* _data;
+    const Layout* _layout;
+    uint32_t _row;
+    uint32_t _col;
+};
+
+/** @cond */
+template<typename Value, typename Layout, bool ContiguousRows=Layout::kContiguousRows>
+struct GridRowTraits
+{
+    typedef Value* iterator;
+    static iterator make(Value* data, const Layout& layout, uint32_t row, uint32_t col) {
+        return data + layout.index(row, col);
+    }
+};
+
+template<typename Value, typename Layout>
+struct GridRowTraits<Value, Layout, false>
+{
+    typedef GridRowIterator<Value, Layout> iterator;
+    static iterator make(Value* data, const Layout& layout, uint32_t row, uint32_t col) {
+        return iterator(data, &layout, row, col);
+    }
+};
+/** @endcond */
+
 /**
  * @class Grid grid.hpp "cinek/overview/grid.hpp"
  * @brief Defines a 2D grid of data of type T.
+ *
+ * The Layout policy decides how values are ordered in memory (see
+ * RowMajorLayout, TiledLayout and MortonLayout.)  With a row-major layout,
+ * row strips are plain pointers into the grid's storage - otherwise they're
+ * GridRowIterators, which are used the same way.
  */
-template<typename Value>
+template<typename Value, typename Layout=RowMajorLayout>
 class Grid
 {
 public:
+    /** The grid's storage layout policy. */
+    typedef Layout layout_type;
+    /** Iterates the values of a row strip. */
+    typedef typename GridRowTraits<Value, Layout>::iterator row_iterator;
+    /** Const version of a row_iterator. */
+    typedef typename GridRowTraits<const Value, Layout>::iterator const_row_iterator;
     /**
      *  Defines a start and end point for T items in a row.  The end pointer
      *  points past the last item in the strip (iteration should stop if the compared
      *  pointer is greater than or equal to the end pointer.
      */
-    typedef std::pair<Value*, Value*> row_strip;
+    typedef std::pair<row_iterator, row_iterator> row_strip;
     /** Const version of a row_strip */
-    typedef std::pair<const Value*, const Value*> const_row_strip;
+    typedef std::pair<const_row_iterator, const_row_iterator> const_row_strip;
 
     Grid(const Grid& ) = delete;
     Grid& operator=(const Grid& ) = delete;
@@ -69,6 +285,8 @@ public:
     uint32_t rowCount() const { return _rowCount; }
     /** @return Number of columns in grid */
     uint32_t columnCount() const { return _colCount; }
+    /** @return The grid's storage layout. */
+    const Layout& layout() const { return _layout; }
     /**
      * Gets a const reference of the value at the specified row, column.
      * @param  row The row [0, rowCount-1]
@@ -83,6 +301,16 @@ public:
      * @return     A reference of the value at row,col.
      */
     Value& at(uint32_t row, uint32_t col);
+    /**
+     * Sets the value at the specified row, column.  Matches ChunkedGrid::set,
+     * so code written against either grid can write values the same way.
+     * @param  row      The row [0, rowCount-1]
+     * @param  col      The column [0, columnCount-1]
+     * @param  value    The value to set
+     */
+    void set(uint32_t row, uint32_t col, const Value& value) {
+        at(row, col) = value;
+    }
     /**
      * Returns a pointer to the data row in the grid.  To retrieve data at a
      * specific column, use pointer math, atRow(row) + columnIndex.
@@ -122,6 +350,7 @@ private:
     Value* _data;
     uint32_t _rowCount;
     uint32_t _colCount;
+    Layout _layout;
 };
 
 /**
@@ -277,25 +506,27 @@ private:
 
 
 ///////////////////////////////////////////////////////////////////////////////
-template<typename Value>
-Grid<Value>::Grid() :
+template<typename Value, typename Layout>
+Grid<Value, Layout>::Grid() :
     _data(nullptr),
     _rowCount(0),
-    _colCount(0)
+    _colCount(0),
+    _layout()
 {
 }
 
-template<typename Value>
-Grid<Value>::Grid(uint32_t rowCount, uint32_t columnCount) :
+template<typename Value, typename Layout>
+Grid<Value, Layout>::Grid(uint32_t rowCount, uint32_t columnCount) :
     _data(nullptr),
     _rowCount(rowCount),
-    _colCount(columnCount)
+    _colCount(columnCount),
+    _layout(rowCount, columnCount)
 {
-    _data = (Value*)malloc(_rowCount * _colCount * sizeof(Value));
+    _data = (Value*)malloc(_layout.size() * sizeof(Value));
 }
 
-template<typename Value>
-Grid<Value>::~Grid()
+template<typename Value, typename Layout>
+Grid<Value, Layout>::~Grid()
 {
     if (_data != nullptr)
     {
@@ -303,84 +534,87 @@ Grid<Value>::~Grid()
     }
 }
 
-template<typename Value>
-Grid<Value>::Grid(Grid&& grid) noexcept :
+template<typename Value, typename Layout>
+Grid<Value, Layout>::Grid(Grid&& grid) noexcept :
     _data(grid._data),
     _rowCount(grid._rowCount),
-    _colCount(grid._colCount)
+    _colCount(grid._colCount),
+    _layout(grid._layout)
 {
     grid._data = nullptr;
     grid._rowCount = 0;
     grid._colCount = 0;
+    grid._layout = Layout();
 }
 
-template<typename Value>
-Grid<Value>& Grid<Value>::operator=(Grid&& grid) noexcept {
+template<typename Value, typename Layout>
+Grid<Value, Layout>& Grid<Value, Layout>::operator=(Grid&& grid) noexcept {
     _data = grid._data;
     _rowCount = grid._rowCount;
     _colCount = grid._colCount;
+    _layout = grid._layout;
 
     grid._data = nullptr;
     grid._rowCount = grid._colCount = 0;
+    grid._layout = Layout();
 
     return *this;
 }
-template<typename Value>
-const Value& Grid<Value>::at(uint32_t row, uint32_t col) const
+template<typename Value, typename Layout>
+const Value& Grid<Value, Layout>::at(uint32_t row, uint32_t col) const
 {
-    const Value* rowData = _data + (_colCount * row);
-    return *(rowData + col);
+    return _data[_layout.index(row, col)];
 }
 
-template<typename Value>
-Value& Grid<Value>::at(uint32_t row, uint32_t col)
+template<typename Value, typename Layout>
+Value& Grid<Value, Layout>::at(uint32_t row, uint32_t col)
 {
     return const_cast<Value&>(
-            reinterpret_cast<const Grid<Value>* >(this)->at(row, col)
+            reinterpret_cast<const Grid<Value, Layout>* >(this)->at(row, col)
         );
 }
 
 
-template<typename Value>
-typename Grid<Value>::const_row_strip
-    Grid<Value>::atRow(uint32_t row, uint32_t col, uint32_t length /*=0*/) const
+template<typename Value, typename Layout>
+typename Grid<Value, Layout>::const_row_strip
+    Grid<Value, Layout>::atRow(uint32_t row, uint32_t col, uint32_t length /*=0*/) const
 {
     if (row >= _rowCount || col >= _colCount)
         return const_row_strip();
-    const Value* rowStart = _data + (_colCount * row);
     if (length == UINT32_MAX)
         length = _colCount - col;
     uint32_t endCol = std::min(col+length, _colCount);
-    return std::make_pair(rowStart+col, rowStart+endCol);
+    typedef GridRowTraits<const Value, Layout> Traits;
+    const Value* data = _data;
+    return std::make_pair(Traits::make(data, _layout, row, col),
+                          Traits::make(data, _layout, row, col) + (endCol-col));
 }
 
-template<typename Value>
-typename Grid<Value>::row_strip
-    Grid<Value>::atRow(uint32_t row, uint32_t col, uint32_t length /*=0*/)
+template<typename Value, typename Layout>
+typename Grid<Value, Layout>::row_strip
+    Grid<Value, Layout>::atRow(uint32_t row, uint32_t col, uint32_t length /*=0*/)
 {
     if (row >= _rowCount || col >= _colCount)
         return row_strip();
-    Value* rowStart = _data + (_colCount * row);
     if (length == UINT32_MAX)
         length = _colCount - col;
     uint32_t endCol = std::min(col+length, _colCount);
-    return std::make_pair(rowStart+col, rowStart+endCol);
+    typedef GridRowTraits<Value, Layout> Traits;
+    return std::make_pair(Traits::make(_data, _layout, row, col),
+                          Traits::make(_data, _layout, row, col) + (endCol-col));
 }
 
-template<typename Value>
-void Grid<Value>::fillWithValue(Value value,
+template<typename Value, typename Layout>
+void Grid<Value, Layout>::fillWithValue(Value value,
                         uint32_t row, uint32_t col,
                         uint32_t rows, uint32_t cols)
 {
     for (uint32_t r = row; r < row + rows; ++r)
     {
-        typename Grid<Value>::row_strip rowStrip = atRow(r, col, cols);
+        typename Grid<Value, Layout>::row_strip rowStrip = atRow(r, col, cols);
         if (rowStrip == row_strip())
             continue;
-        for (; rowStrip.first < rowStrip.second; ++rowStrip.first)
-        {
-            *rowStrip.first = value;
-        }
+        std::fill(rowStrip.first, rowStrip.second, value);
     }
 }
 
@@ -0,0 +1,454 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef CINEK_OVERVIEW_GRIDOPS_HPP
+#define CINEK_OVERVIEW_GRIDOPS_HPP
+
+#include "grid.hpp"
+
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//  Bulk operations on the rectangles of grids described by GridContainers.
+//
+//  Each operation works a row strip at a time.  When the strips are plain
+//  pointers (row-major Grids) and the values are trivially copyable, fills,
+//  copies and comparisons become memset/memmove/memcmp calls and the other
+//  loops run over contiguous memory the compiler can vectorize.  Other
+//  layouts and ChunkedGrids fall back to iterating each strip.
+//
+//  Values are compared bytewise when trivially copyable (so types like Tile
+//  need no operator==), and with operator== otherwise.
+//
+namespace cinekine {
+    namespace overview {
+
+/** @cond */
+template<typename Value, uint32_t ChunkSize> class ChunkedGrid;
+
+namespace gridops {
+
+//  the number of items in a row strip - 0 for the null strips returned for
+//  rows past the grid's bottom edge.
+template<typename Strip>
+size_t stripLength(const Strip& strip)
+{
+    return strip.second - strip.first;
+}
+
+//  Grids whose non-const row strips allocate storage as they're written,
+//  and so can't be written from several threads.
+template<class GridType>
+struct AllocatesOnWrite : std::false_type {};
+
+template<typename Value, uint32_t ChunkSize>
+struct AllocatesOnWrite<ChunkedGrid<Value, ChunkSize>> : std::true_type {};
+
+template<class Container>
+struct ContainerAllocatesOnWrite : std::false_type {};
+
+template<class GridType>
+struct ContainerAllocatesOnWrite<GridContainer<GridType>> : AllocatesOnWrite<GridType> {};
+
+template<typename Strip>
+struct StripTraits
+{
+    typedef typename Strip::first_type iterator;
+    static const bool kPointer = std::is_pointer<iterator>::value;
+};
+
+template<typename Value>
+struct ValueTraits
+{
+    static const bool kTrivial = std::is_trivially_copyable<Value>::value;
+
+    static bool equal(const Value& a, const Value& b) {
+        return equal(a, b, std::integral_constant<bool, kTrivial>());
+    }
+    static bool equal(const Value& a, const Value& b, std::true_type) {
+        return !memcmp(&a, &b, sizeof(Value));
+    }
+    static bool equal(const Value& a, const Value& b, std::false_type) {
+        return a == b;
+    }
+    //  true if memset can write the value
+    static bool byteUniform(const Value& value) {
+        if (!kTrivial)
+            return false;
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        for (size_t i = 1; i < sizeof(Value); ++i)
+        {
+            if (bytes[i] != bytes[0])
+                return false;
+        }
+        return true;
+    }
+};
+
+template<typename Strip, typename Value>
+void fillStrip(const Strip& strip, const Value& value, std::true_type /*pointer*/)
+{
+    size_t count = strip.second - strip.first;
+    if (ValueTraits<Value>::byteUniform(value))
+        memset((void*)strip.first, *reinterpret_cast<const uint8_t*>(&value),
+               count * sizeof(Value));
+    else
+        std::fill(strip.first, strip.second, value);
+}
+
+template<typename Strip, typename Value>
+void fillStrip(const Strip& strip, const Value& value, std::false_type)
+{
+    std::fill(strip.first, strip.second, value);
+}
+
+template<typename DestStrip, typename SrcStrip>
+void copyStrip(const DestStrip& dest, const SrcStrip& src, size_t count, std::true_type)
+{
+    memmove((void*)dest.first, (const void*)src.first, count * sizeof(*dest.first));
+}
+
+template<typename DestStrip, typename SrcStrip>
+void copyStrip(const DestStrip& dest, const SrcStrip& src, size_t count, std::false_type)
+{
+    std::copy(src.first, src.first + count, dest.first);
+}
+
+template<typename StripA, typename StripB>
+bool equalStrips(const StripA& a, const StripB& b, size_t count, std::true_type)
+{
+    return !memcmp((const void*)a.first, (const void*)b.first, count * sizeof(*a.first));
+}
+
+template<typename StripA, typename StripB>
+bool equalStrips(const StripA& a, const StripB& b, size_t count, std::false_type)
+{
+    typedef typename std::decay<decltype(*a.first)>::type Value;
+    typename StripA::first_type itA = a.first;
+    typename StripB::first_type itB = b.first;
+    for (size_t i = 0; i < count; ++i, ++itA, ++itB)
+    {
+        if (!ValueTraits<Value>::equal(*itA, *itB))
+            return false;
+    }
+    return true;
+}
+
+} /* namespace gridops */
+/** @endcond */
+
+/**
+ * Fills every item in the container with a value.
+ * @param dest      The container to fill.
+ * @param value     The value to set.
+ */
+template<class GridType, typename Value>
+void fillGrid(GridContainer<GridType>& dest, const Value& value)
+{
+    typedef typename GridContainer<GridType>::row_strip Strip;
+    typedef typename std::decay<decltype(*Strip().first)>::type GridValue;
+    typedef std::integral_constant<bool,
+        gridops::StripTraits<Strip>::kPointer && gridops::ValueTraits<GridValue>::kTrivial>
+        FastPath;
+    const GridValue gridValue = value;
+    for (uint32_t row = 0; row < dest.rowCount(); ++row)
+    {
+        gridops::fillStrip(dest.atRow(row), gridValue, FastPath());
+    }
+}
+
+/**
+ * Fills the items in the container where the matching mask item is nonzero,
+ * clipped to the smaller of the two containers and to the grids' edges.
+ * @param dest      The container to fill.
+ * @param mask      The mask container, whose values are tested as bools.
+ * @param value     The value to set.
+ */
+template<class GridType, class MaskGridType, typename Value>
+void fillGridMasked(GridContainer<GridType>& dest,
+                    const GridContainer<MaskGridType>& mask,
+                    const Value& value)
+{
+    uint32_t rows = std::min(dest.rowCount(), mask.rowCount());
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        auto destStrip = dest.atRow(row);
+        auto maskStrip = mask.atRow(row);
+        size_t count = std::min(gridops::stripLength(destStrip),
+                                gridops::stripLength(maskStrip));
+        auto destIt = destStrip.first;
+        auto maskIt = maskStrip.first;
+        for (size_t i = 0; i < count; ++i, ++destIt, ++maskIt)
+        {
+            if (*maskIt)
+                *destIt = value;
+        }
+    }
+}
+
+/**
+ * Copies the items of one container into another, clipped to the smaller
+ * of the two and to the grids' edges.  With row-major grids the source and destination may overlap
+ * (for example, when scrolling a rectangle within a grid.)
+ * @param dest      The container to copy into.
+ * @param src       The container to copy from.
+ */
+template<class DestGridType, class SrcGridType>
+void copyGrid(GridContainer<DestGridType>& dest, const GridContainer<SrcGridType>& src)
+{
+    typedef typename GridContainer<DestGridType>::row_strip DestStrip;
+    typedef typename GridContainer<SrcGridType>::const_row_strip SrcStrip;
+    typedef typename std::decay<decltype(*DestStrip().first)>::type DestValue;
+    typedef typename std::decay<decltype(*SrcStrip().first)>::type SrcValue;
+    typedef std::integral_constant<bool,
+        gridops::StripTraits<DestStrip>::kPointer &&
+        gridops::StripTraits<SrcStrip>::kPointer &&
+        std::is_same<DestValue, SrcValue>::value &&
+        gridops::ValueTraits<DestValue>::kTrivial>
+        FastPath;
+
+    uint32_t rows = std::min(dest.rowCount(), src.rowCount());
+    if (!rows)
+        return;
+
+    //  copying downwards within a grid must start from the bottom row, so
+    //  that no source row is overwritten before it's copied.
+    bool bottomUp = false;
+    if (FastPath::value)
+    {
+        DestStrip destStrip = dest.atRow(0);
+        SrcStrip srcStrip = src.atRow(0);
+        bottomUp = gridops::stripLength(destStrip) && gridops::stripLength(srcStrip) &&
+            std::greater<const void*>()((const void*)&*destStrip.first,
+                                        (const void*)&*srcStrip.first);
+    }
+    for (uint32_t i = 0; i < rows; ++i)
+    {
+        uint32_t row = bottomUp ? rows-1 - i : i;
+        DestStrip destStrip = dest.atRow(row);
+        SrcStrip srcStrip = src.atRow(row);
+        size_t count = std::min(gridops::stripLength(destStrip),
+                                gridops::stripLength(srcStrip));
+        if (count)
+            gridops::copyStrip(destStrip, srcStrip, count, FastPath());
+    }
+}
+
+/**
+ * Replaces each item in the container with the result of a function.
+ * @param dest      The container to transform.
+ * @param fn        Called as fn(value), returning the new value.
+ */
+template<class GridType, typename Fn>
+void transformGrid(GridContainer<GridType>& dest, Fn fn)
+{
+    for (uint32_t row = 0; row < dest.rowCount(); ++row)
+    {
+        auto strip = dest.atRow(row);
+        std::transform(strip.first, strip.second, strip.first, fn);
+    }
+}
+
+/**
+ * Writes the result of a function of each source item into the matching
+ * destination item, clipped to the smaller container and the grids' edges.
+ * @param dest      The container to write.
+ * @param src       The container to read.
+ * @param fn        Called as fn(srcValue), returning the destination value.
+ */
+template<class DestGridType, class SrcGridType, typename Fn>
+void transformGrid(GridContainer<DestGridType>& dest,
+                   const GridContainer<SrcGridType>& src, Fn fn)
+{
+    uint32_t rows = std::min(dest.rowCount(), src.rowCount());
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        auto destStrip = dest.atRow(row);
+        auto srcStrip = src.atRow(row);
+        size_t count = std::min(gridops::stripLength(destStrip),
+                                gridops::stripLength(srcStrip));
+        if (count)
+            std::transform(srcStrip.first, srcStrip.first + count, destStrip.first, fn);
+    }
+}
+
+/**
+ * Counts the items in the container equal to a value.
+ * @param container The container to search.
+ * @param value     The value to count.
+ * @return          The number of matching items.
+ */
+template<class GridType, typename Value>
+size_t countGrid(const GridContainer<GridType>& container, const Value& value)
+{
+    typedef typename GridContainer<GridType>::const_row_strip Strip;
+    typedef typename std::decay<decltype(*Strip().first)>::type GridValue;
+    const GridValue gridValue = value;
+    size_t count = 0;
+    for (uint32_t row = 0; row < container.rowCount(); ++row)
+    {
+        Strip strip = container.atRow(row);
+        for (; strip.first < strip.second; ++strip.first)
+        {
+            count += gridops::ValueTraits<GridValue>::equal(*strip.first, gridValue);
+        }
+    }
+    return count;
+}
+
+/**
+ * Counts the items in the container matching a predicate.
+ * @param container The container to search.
+ * @param pred      Called as pred(value), returning true for a match.
+ * @return          The number of matching items.
+ */
+template<class GridType, typename Pred>
+size_t countGridIf(const GridContainer<GridType>& container, Pred pred)
+{
+    size_t count = 0;
+    for (uint32_t row = 0; row < container.rowCount(); ++row)
+    {
+        auto strip = container.atRow(row);
+        for (; strip.first < strip.second; ++strip.first)
+        {
+            count += pred(*strip.first) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+/**
+ * Compares the items of two containers.
+ * @param a         The first container.
+ * @param b         The second container.
+ * @return          True if the containers have the same dimensions and
+ *                  items.  Parts of a container past its grid's edges
+ *                  aren't compared, but must be the same size in both.
+ */
+template<class GridTypeA, class GridTypeB>
+bool gridsEqual(const GridContainer<GridTypeA>& a, const GridContainer<GridTypeB>& b)
+{
+    typedef typename GridContainer<GridTypeA>::const_row_strip StripA;
+    typedef typename GridContainer<GridTypeB>::const_row_strip StripB;
+    typedef typename std::decay<decltype(*StripA().first)>::type ValueA;
+    typedef typename std::decay<decltype(*StripB().first)>::type ValueB;
+    typedef std::integral_constant<bool,
+        gridops::StripTraits<StripA>::kPointer &&
+        gridops::StripTraits<StripB>::kPointer &&
+        std::is_same<ValueA, ValueB>::value &&
+        gridops::ValueTraits<ValueA>::kTrivial>
+        FastPath;
+
+    if (a.rowCount() != b.rowCount() || a.colCount() != b.colCount())
+        return false;
+    for (uint32_t row = 0; row < a.rowCount(); ++row)
+    {
+        StripA stripA = a.atRow(row);
+        StripB stripB = b.atRow(row);
+        size_t count = gridops::stripLength(stripA);
+        if (count != gridops::stripLength(stripB))
+            return false;
+        if (count && !gridops::equalStrips(stripA, stripB, count, FastPath()))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Runs a function on every row strip of the container, dividing the rows
+ * into bands run on separate threads (the calling thread runs the last
+ * band.)  The function must only touch its own strip.  The non-const strips
+ * of a ChunkedGrid allocate chunks as they're written, which isn't thread
+ * safe - ChunkedGrids are only accepted through const containers.
+ * @param container     The container whose rows are visited.
+ * @param fn            Called as fn(strip, row) with the row's strip and
+ *                      its index within the container.
+ * @param threadCount   The number of threads to use, or 0 for one per
+ *                      hardware thread.
+ */
+template<class Container, typename Fn>
+void forEachRowParallel(Container& container, Fn fn, uint32_t threadCount=0)
+{
+    static_assert(!gridops::ContainerAllocatesOnWrite<Container>::value,
+                  "ChunkedGrid rows can only be visited in parallel through a const container");
+    if (!threadCount)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = std::min(threadCount, container.rowCount());
+    if (!threadCount)
+        return;
+
+    auto runBand = [&container, &fn](uint32_t beginRow, uint32_t endRow)
+    {
+        for (uint32_t row = beginRow; row < endRow; ++row)
+        {
+            fn(container.atRow(row), row);
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount-1);
+    uint32_t beginRow = 0;
+    for (uint32_t band = 0; band < threadCount; ++band)
+    {
+        uint32_t endRow = (uint32_t)((uint64_t)container.rowCount() * (band+1) / threadCount);
+        if (band+1 < threadCount)
+            threads.emplace_back(runBand, beginRow, endRow);
+        else
+            runBand(beginRow, endRow);
+        beginRow = endRow;
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * A row-wise parallel transformGrid.  Not available for ChunkedGrids (see
+ * forEachRowParallel.)
+ * @param dest          The container to transform.
+ * @param fn            Called as fn(value), returning the new value.  Must
+ *                      be safe to call from several threads.
+ * @param threadCount   The number of threads to use, or 0 for one per
+ *                      hardware thread.
+ */
+template<class GridType, typename Fn>
+void transformGridParallel(GridContainer<GridType>& dest, Fn fn, uint32_t threadCount=0)
+{
+    typedef typename GridContainer<GridType>::row_strip Strip;
+    forEachRowParallel(dest,
+        [&fn](Strip strip, uint32_t)
+        {
+            std::transform(strip.first, strip.second, strip.first, fn);
+        },
+        threadCount);
+}
+
+    } /* overview */
+} /* cinekine */
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "maptypes.hpp"
 #include "grid.hpp"
+#include "chunkedgrid.hpp"
 
 #include <vector>
 
@@ -19,8 +20,25 @@
 namespace cinekine {
     namespace overview {
 
-/** Defines a grid of tiles */
+/**
+ * Defines a grid of tiles.  Tiles are stored in chunks allocated as they're
+ * painted, so a map's memory follows its carved space rather than its
+ * bounds.  Read tiles through a const Tilemap (and write them with set) to
+ * avoid allocating chunks that are only looked at.
+ *
+ * Define one of GENROOM_TILEMAP_ROWMAJOR, GENROOM_TILEMAP_TILED or
+ * GENROOM_TILEMAP_MORTON (see the GENROOM_TILEMAP CMake option) to store
+ * tiles in a dense Grid with that layout instead.
+ */
+#if defined(GENROOM_TILEMAP_ROWMAJOR)
 typedef Grid<Tile> Tilemap;
+#elif defined(GENROOM_TILEMAP_TILED)
+typedef Grid<Tile, TiledLayout<8>> Tilemap;
+#elif defined(GENROOM_TILEMAP_MORTON)
+typedef Grid<Tile, MortonLayout> Tilemap;
+#else
+typedef ChunkedGrid<Tile> Tilemap;
+#endif
 /** Defines a tilemap section */
 typedef GridContainer<Tilemap> TilemapContainer;
 
@@ -354,7 +354,7 @@ public:
         }
     }
 
-    void drawTilemap(cinekine::overview::Tilemap* grid)
+    void drawTilemap(const cinekine::overview::Tilemap* grid)
     {
         if (!grid)
             return;
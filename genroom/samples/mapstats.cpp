@@ -0,0 +1,288 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+//  Builds a large map with the Builder, without any graphics, and reports on
+//  its tilemap - how much of the map's storage the carved rooms actually
+//  needed, and how quickly each Grid layout runs the wall painter's
+//  neighbour reads.
+//
+//      mapstats [width] [height] [room count] [seed]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "map.hpp"
+#include "gridops.hpp"
+#include "builder.hpp"
+#include "tiledatabase.hpp"
+
+const uint8_t kTileCategory_Dungeon             = 1;
+const uint8_t kTileClass_Stone                  = 1;
+
+struct TileDef
+{
+    cinekine::overview::TileHandle handle;
+    uint16_t roleFlags;
+};
+
+//  the tiles of the GL sample's stone dungeon
+const TileDef kTileDefs[] = {
+    { 1,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_N },
+    { 2,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_NE },
+    { 3,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_E },
+    { 4,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_SE },
+    { 5,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_S },
+    { 6,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_SW },
+    { 7,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_W },
+    { 8,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileDirection_NW },
+    { 9,    cinekine::overview::kTileRole_Wall | cinekine::overview::kTileRole_Corner |
+            cinekine::overview::kTileDirection_NW },
+    { 10,   cinekine::overview::kTileRole_Wall | cinekine::overview::kTileRole_Corner |
+            cinekine::overview::kTileDirection_NE },
+    { 12,   cinekine::overview::kTileRole_Wall | cinekine::overview::kTileRole_Corner |
+            cinekine::overview::kTileDirection_SE },
+    { 13,   cinekine::overview::kTileRole_Wall | cinekine::overview::kTileRole_Corner |
+            cinekine::overview::kTileDirection_SW },
+    { 64,   cinekine::overview::kTileRole_Floor }
+};
+
+//  places rooms at random, skipping any that would overlap an earlier room,
+//  and connects each room to the one before it.
+//
+static uint32_t buildRooms(cinekine::overview::Builder& builder,
+                           const cinekine::overview::MapBounds& bounds,
+                           uint32_t roomCount)
+{
+    const cinekine::overview::TileBrush brush = { kTileCategory_Dungeon, kTileClass_Stone };
+    std::vector<cinekine::overview::Box> rooms;
+    int lastRegion = -1;
+    for (uint32_t attempt = 0; attempt < roomCount * 8 && rooms.size() < roomCount; ++attempt)
+    {
+        int32_t w = 5 + rand() % 12;
+        int32_t h = 5 + rand() % 12;
+        if (w >= (int32_t)bounds.xUnits || h >= (int32_t)bounds.yUnits)
+            break;
+        int32_t x = rand() % (bounds.xUnits - w);
+        int32_t y = rand() % (bounds.yUnits - h);
+        cinekine::overview::Box box = { cinekine::overview::Box::Point(x, y),
+                                        cinekine::overview::Box::Point(x + w, y + h) };
+        bool overlaps = false;
+        for (auto& room : rooms)
+        {
+            overlaps |= room.intersects(box);
+        }
+        if (overlaps)
+            continue;
+
+        std::vector<cinekine::overview::NewRegionInstruction> instructions;
+        instructions.emplace_back(cinekine::overview::NewRegionInstruction::kRandomize);
+        instructions.back().box = box;
+        instructions.back().terminal = true;
+        int region = builder.makeRegion(brush, instructions);
+        if (region < 0)
+            continue;
+        rooms.push_back(box);
+        if (lastRegion >= 0)
+        {
+            std::vector<cinekine::overview::MapPoint> connectPoints;
+            builder.connectRegions(brush, lastRegion, region, connectPoints);
+        }
+        lastRegion = region;
+    }
+    return (uint32_t)rooms.size();
+}
+
+//  the neighbour reads Builder::paintTileWalls makes: counts floor tiles with
+//  a wall or the map's edge on any of their four sides.
+//
+template<typename TileGrid>
+static void timeNeighbourPass(const char* name, const TileGrid& tilemap)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t edgeCount = 0;
+    const uint32_t rows = tilemap.rowCount();
+    const uint32_t cols = tilemap.columnCount();
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        for (uint32_t col = 0; col < cols; ++col)
+        {
+            if (!tilemap.at(row, col).floor)
+                continue;
+            if (row == 0 || !tilemap.at(row-1, col).floor ||
+                row+1 == rows || !tilemap.at(row+1, col).floor ||
+                col == 0 || !tilemap.at(row, col-1).floor ||
+                col+1 == cols || !tilemap.at(row, col+1).floor)
+            {
+                ++edgeCount;
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start);
+    printf("%-14s: %zu edge tiles in %lld us\n", name, edgeCount,
+           (long long)elapsed.count());
+}
+
+//  a chunked Tilemap reports its memory against a dense grid, then demolishes
+//  the east half of the map and lets compact hand back the chunks that are
+//  empty again.
+//
+template<typename Value, uint32_t ChunkSize>
+static void reportStorage(cinekine::overview::ChunkedGrid<Value, ChunkSize>& tilemap)
+{
+    const cinekine::overview::ChunkedGrid<Value, ChunkSize>& readTilemap = tilemap;
+    const size_t denseBytes = (size_t)tilemap.rowCount() * tilemap.columnCount() * sizeof(Value);
+    printf("dense grid    : %zu KB\n", denseBytes / 1024);
+    printf("chunked grid  : %zu KB in %zu chunks\n",
+           tilemap.allocatedBytes() / 1024, tilemap.allocatedChunkCount());
+
+    const Value emptyTile = { 0, 0 };
+    for (uint32_t row = 0; row < readTilemap.rowCount(); ++row)
+    {
+        for (uint32_t col = readTilemap.columnCount() / 2; col < readTilemap.columnCount(); ++col)
+        {
+            const Value& tile = readTilemap.at(row, col);
+            if (tile.floor || tile.wall)
+                tilemap.set(row, col, emptyTile);
+        }
+    }
+    printf("east cleared  : %zu KB in %zu chunks\n",
+           tilemap.allocatedBytes() / 1024, tilemap.allocatedChunkCount());
+    size_t released = tilemap.compact();
+    printf("after compact : %zu KB in %zu chunks (%zu released)\n",
+           tilemap.allocatedBytes() / 1024, tilemap.allocatedChunkCount(), released);
+}
+
+//  a dense Tilemap (see GENROOM_TILEMAP) always holds the whole map.
+//
+template<typename Value, typename Layout>
+static void reportStorage(cinekine::overview::Grid<Value, Layout>& tilemap)
+{
+    const size_t denseBytes = (size_t)tilemap.rowCount() * tilemap.columnCount() * sizeof(Value);
+    printf("dense grid    : %zu KB\n", denseBytes / 1024);
+}
+
+int main(int argc, const char* argv[])
+{
+    uint32_t width = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 2048;
+    uint32_t height = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 2048;
+    uint32_t roomCount = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 64;
+    unsigned seed = argc > 4 ? (unsigned)strtoul(argv[4], NULL, 10) : 1;
+    if (width < 32 || height < 32 || width > 8192 || height > 8192)
+    {
+        printf("mapstats [width] [height] [room count] [seed]\n");
+        printf("  width and height are in tiles, from 32 to 8192\n");
+        return 1;
+    }
+    srand(seed);
+
+    cinekine::overview::TileDatabase tileTemplates(256);
+    for (auto& tileDef : kTileDefs)
+    {
+        cinekine::overview::TileTemplate tileTemplate;
+        tileTemplate.bitmapHandle = tileDef.handle;
+        tileTemplate.roleFlags = tileDef.roleFlags;
+        tileTemplate.classId = kTileClass_Stone;
+        tileTemplate.categoryId = kTileCategory_Dungeon;
+        tileTemplate.params[0] = 0;
+        tileTemplate.params[1] = 0;
+        tileTemplates.mapTemplate(tileDef.handle, tileTemplate);
+    }
+
+    cinekine::overview::MapBounds bounds = { width, height, 1 };
+    cinekine::overview::Map map(bounds);
+    cinekine::overview::Builder builder(map, tileTemplates, roomCount);
+    uint32_t roomsBuilt = buildRooms(builder, bounds, roomCount);
+
+    cinekine::overview::Tilemap& tilemap = *map.tilemapAtZ(0);
+    const cinekine::overview::Tilemap& readTilemap = tilemap;
+    const cinekine::overview::GridContainer<const cinekine::overview::Tilemap> readContainer(readTilemap);
+    const size_t floorCount = cinekine::overview::countGridIf(readContainer,
+        [](const cinekine::overview::Tile& tile) { return tile.floor != 0; });
+    printf("%ux%u map, %u rooms, %zu floor tiles\n", width, height, roomsBuilt, floorCount);
+
+    //  the neighbour pass over copies of the map in each dense layout
+    cinekine::overview::Grid<cinekine::overview::Tile> rowMajor(height, width);
+    cinekine::overview::Grid<cinekine::overview::Tile,
+                             cinekine::overview::TiledLayout<8>> tiled(height, width);
+    cinekine::overview::Grid<cinekine::overview::Tile,
+                             cinekine::overview::MortonLayout> morton(height, width);
+    cinekine::overview::GridContainer<decltype(rowMajor)> rowMajorContainer(rowMajor);
+    cinekine::overview::GridContainer<decltype(tiled)> tiledContainer(tiled);
+    cinekine::overview::GridContainer<decltype(morton)> mortonContainer(morton);
+    cinekine::overview::copyGrid(rowMajorContainer, readContainer);
+    cinekine::overview::copyGrid(tiledContainer, readContainer);
+    cinekine::overview::copyGrid(mortonContainer, readContainer);
+    if (!cinekine::overview::gridsEqual(rowMajorContainer, tiledContainer) ||
+        !cinekine::overview::gridsEqual(rowMajorContainer, mortonContainer))
+    {
+        printf("layout copies differ from the tilemap\n");
+        return 1;
+    }
+    timeNeighbourPass("row-major", rowMajor);
+    timeNeighbourPass("tiled (8)", tiled);
+    timeNeighbourPass("morton", morton);
+
+    //  the bulk grid operations: wall tiles counted row by row in parallel,
+    //  and the floor plan rebuilt from a mask of the tilemap's floors.
+    std::vector<size_t> rowWallCounts(readContainer.rowCount());
+    cinekine::overview::forEachRowParallel(readContainer,
+        [&rowWallCounts](cinekine::overview::GridContainer<const cinekine::overview::Tilemap>::const_row_strip strip,
+                         uint32_t row)
+        {
+            for (auto it = strip.first; it != strip.second; ++it)
+            {
+                rowWallCounts[row] += (*it).wall != 0;
+            }
+        });
+    size_t wallCount = 0;
+    for (auto rowWallCount : rowWallCounts)
+    {
+        wallCount += rowWallCount;
+    }
+
+    cinekine::overview::Grid<uint8_t> floorMask(height, width);
+    cinekine::overview::GridContainer<decltype(floorMask)> floorMaskContainer(floorMask);
+    cinekine::overview::transformGrid(floorMaskContainer, readContainer,
+        [](const cinekine::overview::Tile& tile) -> uint8_t { return tile.floor != 0; });
+    cinekine::overview::transformGridParallel(floorMaskContainer,
+        [](uint8_t isFloor) -> uint8_t { return !isFloor; });
+    const size_t rockCount = cinekine::overview::countGrid(floorMaskContainer, (uint8_t)1);
+    cinekine::overview::transformGrid(floorMaskContainer,
+        [](uint8_t isRock) -> uint8_t { return !isRock; });
+
+    const cinekine::overview::Tile emptyTile = { 0, 0 };
+    const cinekine::overview::Tile floorTile = { 64, 0 };
+    cinekine::overview::fillGrid(rowMajorContainer, emptyTile);
+    cinekine::overview::fillGridMasked(rowMajorContainer, floorMaskContainer, floorTile);
+    printf("gridops       : %zu wall tiles, %zu rock tiles, %zu floors repainted\n",
+           wallCount, rockCount, cinekine::overview::countGrid(rowMajorContainer, floorTile));
+
+    reportStorage(tilemap);
+    return 0;
+}
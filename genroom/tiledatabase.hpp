@@ -55,6 +55,11 @@ namespace cinekine { namespace overview {
          *                which usually indicates an empty tile
          */
         const TileTemplate& tile(TileHandle handle) const;
+        /**
+         * @return The number of tile handles (tileLimit) - handles from 0 to
+         *         tileCount()-1 are valid
+         */
+        size_t tileCount() const { return _tiles.size(); }
         /**
          * Retrieves a TileTemplate from the given description/selection
          * parameters
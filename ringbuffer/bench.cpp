@@ -0,0 +1,886 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "packetbuffer.hpp"
+#include "broadcastpacketbuffer.hpp"
+#include "crc32c.hpp"
+#include "lossypacketbuffer.hpp"
+#include "messagebuffer.hpp"
+#include "mpmcpacketbuffer.hpp"
+#include "ringbuffer.hpp"
+#include "segmentedpacketbuffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+//
+//  Measures PacketBuffer throughput between a producer and a consumer thread.
+//
+//  Three paths are compared:
+//      lockfree - both sides spin (then yield) on the buffer's own indices.
+//      batched  - as lockfree, but using the reserve/commit and peek/release
+//                 methods to move up to batchSize packets per index update.
+//      mutex    - every advance is made under a mutex, with condition
+//                 variables used to wait on a full or empty buffer.  This is
+//                 how the Streamer sample originally synchronized its threads.
+//
+//  The messages path runs a MessageBuffer of the same byte capacity, with
+//  message sizes varying from 8 bytes up to the packet size.
+//
+//  The typed path runs a RingBuffer of 64 byte BenchRecords, constructed in
+//  place by the producer and moved out by the consumer.
+//
+//  With more than one thread per side, an MPMCPacketBuffer is compared
+//  against a single PacketBuffer shared by all threads under one mutex.
+//
+//  The broadcast path has one producer feeding a BroadcastPacketBuffer read
+//  by threadCount consumers, each of which sees every packet.
+//
+//  The segmented path runs a SegmentedPacketBuffer with an occupancy driven
+//  resize policy, starting at the given capacity and allowed to grow to 16
+//  times that.  The producer alternates bursts of batched writes with quiet
+//  stretches of single packets.  The ring grows during the first bursts, and
+//  since the quiet stretches are shorter than the policy's shrink window it
+//  keeps that capacity rather than resizing every cycle.
+//
+//  The checksum lines time CRC32C over every packet on one thread, for the
+//  dispatched implementation and the portable one, against a plain copy of
+//  each packet.
+//
+//  The lossy path runs a LossyPacketBuffer, where the producer never waits
+//  and overwrites packets the consumer hasn't read yet.  Every packet must
+//  be either read (in order) or counted as lost.
+//
+struct BenchConfig
+{
+    uint64_t packetCount;
+    uint32_t packetSize;
+    uint32_t capacity;
+    uint32_t batchSize;
+    uint32_t threadCount;
+};
+
+struct BenchRecord
+{
+    uint64_t value;
+    uint64_t payload[7];
+
+    BenchRecord() : value(0) {}
+    BenchRecord(uint64_t v) : value(v) {}
+};
+
+struct BenchContext
+{
+    const BenchConfig* config;
+    PacketBuffer* buffer;
+    MessageBuffer* messageBuffer;
+    RingBuffer<BenchRecord>* recordBuffer;
+    MPMCPacketBuffer* mpmcBuffer;
+    uint64_t checksum;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t notFull;
+    pthread_cond_t notEmpty;
+};
+
+static void* lockfree_producer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        Packet* packet;
+        while (!(packet = buffer.writeHead()))
+        {
+            sched_yield();
+        }
+        memcpy(packet->data, &i, sizeof(i));
+        buffer.advanceWrite();
+    }
+    return nullptr;
+}
+
+static void* lockfree_consumer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        const Packet* packet;
+        while (!(packet = buffer.readHead()))
+        {
+            sched_yield();
+        }
+        uint64_t value;
+        memcpy(&value, packet->data, sizeof(value));
+        context->checksum += value;
+        buffer.advanceRead();
+    }
+    return nullptr;
+}
+
+static void* batched_producer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+    const uint64_t packetCount = context->config->packetCount;
+
+    for (uint64_t i = 0; i < packetCount; )
+    {
+        uint64_t remaining = packetCount - i;
+        uint32_t batchSize = context->config->batchSize;
+        if (remaining < batchSize)
+            batchSize = (uint32_t)remaining;
+        PacketSpan span = buffer.reserveWrite(batchSize);
+        if (!span.count)
+        {
+            sched_yield();
+            continue;
+        }
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+        {
+            memcpy(span.packets[p].data, &i, sizeof(i));
+        }
+        buffer.commitWrite(span.count);
+    }
+    return nullptr;
+}
+
+static void* batched_consumer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; )
+    {
+        ConstPacketSpan span = buffer.peekRead(UINT32_MAX);
+        if (!span.count)
+        {
+            sched_yield();
+            continue;
+        }
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+        {
+            uint64_t value;
+            memcpy(&value, span.packets[p].data, sizeof(value));
+            context->checksum += value;
+        }
+        buffer.releaseRead(span.count);
+    }
+    return nullptr;
+}
+
+static void* mutex_producer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        pthread_mutex_lock(&context->mutex);
+        Packet* packet;
+        while (!(packet = buffer.writeHead()))
+        {
+            pthread_cond_wait(&context->notFull, &context->mutex);
+        }
+        memcpy(packet->data, &i, sizeof(i));
+        buffer.advanceWrite();
+        pthread_cond_signal(&context->notEmpty);
+        pthread_mutex_unlock(&context->mutex);
+    }
+    return nullptr;
+}
+
+static void* mutex_consumer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        const Packet* packet;
+        pthread_mutex_lock(&context->mutex);
+        while (!(packet = buffer.readHead()))
+        {
+            pthread_cond_wait(&context->notEmpty, &context->mutex);
+        }
+        pthread_mutex_unlock(&context->mutex);
+        uint64_t value;
+        memcpy(&value, packet->data, sizeof(value));
+        context->checksum += value;
+        pthread_mutex_lock(&context->mutex);
+        buffer.advanceRead();
+        pthread_cond_signal(&context->notFull);
+        pthread_mutex_unlock(&context->mutex);
+    }
+    return nullptr;
+}
+
+static void* message_producer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    MessageBuffer& buffer = *context->messageBuffer;
+    const uint32_t sizeSteps = context->config->packetSize / sizeof(uint64_t);
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        uint32_t size = (uint32_t)(1 + (i % sizeSteps)) * sizeof(uint64_t);
+        uint8_t* data;
+        while (!(data = buffer.reserveWrite(size)))
+        {
+            sched_yield();
+        }
+        memcpy(data, &i, sizeof(i));
+        buffer.commitWrite(size);
+    }
+    return nullptr;
+}
+
+static void* message_consumer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    MessageBuffer& buffer = *context->messageBuffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        const uint8_t* data;
+        uint32_t size;
+        while (!(data = buffer.readHead(&size)))
+        {
+            sched_yield();
+        }
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        context->checksum += value;
+        buffer.advanceRead();
+    }
+    return nullptr;
+}
+
+static void* typed_producer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    RingBuffer<BenchRecord>& buffer = *context->recordBuffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        while (!buffer.emplace(i))
+        {
+            sched_yield();
+        }
+    }
+    return nullptr;
+}
+
+static void* typed_consumer(void* arg)
+{
+    BenchContext* context = reinterpret_cast<BenchContext*>(arg);
+    RingBuffer<BenchRecord>& buffer = *context->recordBuffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        BenchRecord record;
+        while (!buffer.take(record))
+        {
+            sched_yield();
+        }
+        context->checksum += record.value;
+    }
+    return nullptr;
+}
+
+static void runBench(const char* name, const BenchConfig& config,
+                     void* (*producer)(void*), void* (*consumer)(void*))
+{
+    PacketBuffer buffer(config.packetSize, config.capacity);
+    MessageBuffer messageBuffer(config.packetSize * config.capacity);
+    RingBuffer<BenchRecord> recordBuffer(config.capacity);
+    BenchContext context;
+    context.config = &config;
+    context.buffer = &buffer;
+    context.messageBuffer = &messageBuffer;
+    context.recordBuffer = &recordBuffer;
+    context.checksum = 0;
+    pthread_mutex_init(&context.mutex, NULL);
+    pthread_cond_init(&context.notFull, NULL);
+    pthread_cond_init(&context.notEmpty, NULL);
+
+    auto start = std::chrono::steady_clock::now();
+
+    pthread_t producerThread, consumerThread;
+    pthread_create(&consumerThread, NULL, consumer, &context);
+    pthread_create(&producerThread, NULL, producer, &context);
+    pthread_join(producerThread, NULL);
+    pthread_join(consumerThread, NULL);
+
+    auto end = std::chrono::steady_clock::now();
+
+    pthread_cond_destroy(&context.notEmpty);
+    pthread_cond_destroy(&context.notFull);
+    pthread_mutex_destroy(&context.mutex);
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t expected = config.packetCount * (config.packetCount - 1) / 2;
+
+    std::cout << name << ": "
+              << (uint64_t)(config.packetCount / seconds) << " packets/sec, "
+              << (uint64_t)(config.packetCount * config.packetSize / seconds / (1024*1024))
+              << " MB/sec"
+              << (context.checksum != expected ? " (CHECKSUM MISMATCH)" : "")
+              << std::endl;
+}
+
+//  Each of the threadCount producers writes its own share of the packet
+//  sequence, and each consumer reads an equal share of packets.
+//
+struct SharedThreadContext
+{
+    BenchContext* context;
+    uint64_t first;
+    uint64_t count;
+    uint64_t checksum;
+};
+
+static void* mpmc_producer(void* arg)
+{
+    SharedThreadContext* thread = reinterpret_cast<SharedThreadContext*>(arg);
+    MPMCPacketBuffer& buffer = *thread->context->mpmcBuffer;
+
+    for (uint64_t i = thread->first; i < thread->first + thread->count; ++i)
+    {
+        PacketTicket ticket;
+        while (!buffer.claimWrite(&ticket))
+        {
+            sched_yield();
+        }
+        memcpy(ticket.packet->data, &i, sizeof(i));
+        buffer.commitWrite(ticket);
+    }
+    return nullptr;
+}
+
+static void* mpmc_consumer(void* arg)
+{
+    SharedThreadContext* thread = reinterpret_cast<SharedThreadContext*>(arg);
+    MPMCPacketBuffer& buffer = *thread->context->mpmcBuffer;
+
+    for (uint64_t i = 0; i < thread->count; ++i)
+    {
+        PacketTicket ticket;
+        while (!buffer.claimRead(&ticket))
+        {
+            sched_yield();
+        }
+        uint64_t value;
+        memcpy(&value, ticket.packet->data, sizeof(value));
+        thread->checksum += value;
+        buffer.releaseRead(ticket);
+    }
+    return nullptr;
+}
+
+static void* shared_mutex_producer(void* arg)
+{
+    SharedThreadContext* thread = reinterpret_cast<SharedThreadContext*>(arg);
+    BenchContext* context = thread->context;
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = thread->first; i < thread->first + thread->count; ++i)
+    {
+        pthread_mutex_lock(&context->mutex);
+        Packet* packet;
+        while (!(packet = buffer.writeHead()))
+        {
+            pthread_cond_wait(&context->notFull, &context->mutex);
+        }
+        memcpy(packet->data, &i, sizeof(i));
+        buffer.advanceWrite();
+        pthread_cond_signal(&context->notEmpty);
+        pthread_mutex_unlock(&context->mutex);
+    }
+    return nullptr;
+}
+
+static void* shared_mutex_consumer(void* arg)
+{
+    SharedThreadContext* thread = reinterpret_cast<SharedThreadContext*>(arg);
+    BenchContext* context = thread->context;
+    PacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < thread->count; ++i)
+    {
+        const Packet* packet;
+        pthread_mutex_lock(&context->mutex);
+        while (!(packet = buffer.readHead()))
+        {
+            pthread_cond_wait(&context->notEmpty, &context->mutex);
+        }
+        uint64_t value;
+        memcpy(&value, packet->data, sizeof(value));
+        thread->checksum += value;
+        buffer.advanceRead();
+        pthread_cond_signal(&context->notFull);
+        pthread_mutex_unlock(&context->mutex);
+    }
+    return nullptr;
+}
+
+static void runSharedBench(const char* name, const BenchConfig& config,
+                           void* (*producer)(void*), void* (*consumer)(void*))
+{
+    PacketBuffer buffer(config.packetSize, config.capacity);
+    MPMCPacketBuffer mpmcBuffer(config.packetSize, config.capacity);
+    BenchContext context;
+    context.config = &config;
+    context.buffer = &buffer;
+    context.mpmcBuffer = &mpmcBuffer;
+    context.checksum = 0;
+    pthread_mutex_init(&context.mutex, NULL);
+    pthread_cond_init(&context.notFull, NULL);
+    pthread_cond_init(&context.notEmpty, NULL);
+
+    const uint32_t threadCount = config.threadCount;
+    const uint64_t packetsPerThread = config.packetCount / threadCount;
+    const uint64_t packetCount = packetsPerThread * threadCount;
+    std::vector<SharedThreadContext> producers(threadCount);
+    std::vector<SharedThreadContext> consumers(threadCount);
+    std::vector<pthread_t> threads(threadCount * 2);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        consumers[i].context = &context;
+        consumers[i].first = 0;
+        consumers[i].count = packetsPerThread;
+        consumers[i].checksum = 0;
+        pthread_create(&threads[i], NULL, consumer, &consumers[i]);
+    }
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        producers[i].context = &context;
+        producers[i].first = i * packetsPerThread;
+        producers[i].count = packetsPerThread;
+        producers[i].checksum = 0;
+        pthread_create(&threads[threadCount + i], NULL, producer, &producers[i]);
+    }
+    for (auto& thread : threads)
+    {
+        pthread_join(thread, NULL);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    pthread_cond_destroy(&context.notEmpty);
+    pthread_cond_destroy(&context.notFull);
+    pthread_mutex_destroy(&context.mutex);
+
+    for (auto& thread : consumers)
+    {
+        context.checksum += thread.checksum;
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t expected = packetCount * (packetCount - 1) / 2;
+
+    std::cout << name << ": "
+              << (uint64_t)(packetCount / seconds) << " packets/sec, "
+              << (uint64_t)(packetCount * config.packetSize / seconds / (1024*1024))
+              << " MB/sec"
+              << (context.checksum != expected ? " (CHECKSUM MISMATCH)" : "")
+              << std::endl;
+}
+
+struct BroadcastThreadContext
+{
+    const BenchConfig* config;
+    BroadcastPacketBuffer* buffer;
+    uint32_t consumer;
+    uint64_t checksum;
+};
+
+static void* broadcast_producer(void* arg)
+{
+    BroadcastThreadContext* thread = reinterpret_cast<BroadcastThreadContext*>(arg);
+    BroadcastPacketBuffer& buffer = *thread->buffer;
+    const uint64_t packetCount = thread->config->packetCount;
+
+    for (uint64_t i = 0; i < packetCount; )
+    {
+        uint64_t remaining = packetCount - i;
+        uint32_t batchSize = thread->config->batchSize;
+        if (remaining < batchSize)
+            batchSize = (uint32_t)remaining;
+        PacketSpan span = buffer.reserveWrite(batchSize);
+        if (!span.count)
+        {
+            buffer.waitForWrite();
+            continue;
+        }
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+        {
+            memcpy(span.packets[p].data, &i, sizeof(i));
+        }
+        buffer.commitWrite(span.count);
+    }
+    return nullptr;
+}
+
+static void* broadcast_consumer(void* arg)
+{
+    BroadcastThreadContext* thread = reinterpret_cast<BroadcastThreadContext*>(arg);
+    BroadcastPacketBuffer& buffer = *thread->buffer;
+
+    for (uint64_t i = 0; i < thread->config->packetCount; )
+    {
+        ConstPacketSpan span = buffer.peekRead(thread->consumer, UINT32_MAX);
+        if (!span.count)
+        {
+            buffer.waitForRead(thread->consumer);
+            continue;
+        }
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+        {
+            uint64_t value;
+            memcpy(&value, span.packets[p].data, sizeof(value));
+            thread->checksum += value;
+        }
+        buffer.releaseRead(thread->consumer, span.count);
+    }
+    return nullptr;
+}
+
+static void runBroadcastBench(const char* name, const BenchConfig& config)
+{
+    BroadcastPacketBuffer buffer(config.packetSize, config.capacity,
+                                 config.threadCount);
+    const uint32_t threadCount = config.threadCount;
+    std::vector<BroadcastThreadContext> threads(threadCount + 1);
+    std::vector<pthread_t> handles(threadCount + 1);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i <= threadCount; ++i)
+    {
+        threads[i].config = &config;
+        threads[i].buffer = &buffer;
+        threads[i].consumer = i;
+        threads[i].checksum = 0;
+        pthread_create(&handles[i], NULL,
+                       i < threadCount ? broadcast_consumer : broadcast_producer,
+                       &threads[i]);
+    }
+    for (auto& handle : handles)
+    {
+        pthread_join(handle, NULL);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t expected = config.packetCount * (config.packetCount - 1) / 2;
+    bool valid = true;
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        valid &= threads[i].checksum == expected;
+    }
+
+    std::cout << name << ": "
+              << (uint64_t)(config.packetCount / seconds) << " packets/sec, "
+              << (uint64_t)(config.packetCount * config.packetSize / seconds / (1024*1024))
+              << " MB/sec to each consumer"
+              << (!valid ? " (CHECKSUM MISMATCH)" : "")
+              << std::endl;
+}
+
+struct LossyContext
+{
+    const BenchConfig* config;
+    LossyPacketBuffer* buffer;
+    std::atomic<bool> producing;
+    uint64_t readCount;
+    bool ordered;
+};
+
+static void* lossy_producer(void* arg)
+{
+    LossyContext* context = reinterpret_cast<LossyContext*>(arg);
+    LossyPacketBuffer& buffer = *context->buffer;
+
+    for (uint64_t i = 0; i < context->config->packetCount; ++i)
+    {
+        Packet* packet = buffer.writeHead();
+        memcpy(packet->data, &i, sizeof(i));
+        buffer.advanceWrite();
+    }
+    context->producing = false;
+    buffer.close();
+    return nullptr;
+}
+
+static void* lossy_consumer(void* arg)
+{
+    LossyContext* context = reinterpret_cast<LossyContext*>(arg);
+    LossyPacketBuffer& buffer = *context->buffer;
+    std::vector<uint8_t> data(context->config->packetSize);
+    uint64_t expected = 0;
+
+    while (buffer.waitForRead())
+    {
+        uint32_t size;
+        uint64_t lost;
+        while (buffer.read(data.data(), (uint32_t)data.size(), &size, &lost))
+        {
+            uint64_t value;
+            memcpy(&value, data.data(), sizeof(value));
+            expected += lost;
+            context->ordered &= value == expected;
+            expected = value + 1;
+            ++context->readCount;
+        }
+    }
+    return nullptr;
+}
+
+static void runLossyBench(const char* name, const BenchConfig& config)
+{
+    LossyPacketBuffer buffer(config.packetSize, config.capacity);
+    LossyContext context;
+    context.config = &config;
+    context.buffer = &buffer;
+    context.producing = true;
+    context.readCount = 0;
+    context.ordered = true;
+
+    auto start = std::chrono::steady_clock::now();
+
+    pthread_t producerThread, consumerThread;
+    pthread_create(&consumerThread, NULL, lossy_consumer, &context);
+    pthread_create(&producerThread, NULL, lossy_producer, &context);
+    pthread_join(producerThread, NULL);
+    pthread_join(consumerThread, NULL);
+
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    bool valid = context.ordered &&
+                 context.readCount + buffer.lostCount() == config.packetCount;
+
+    std::cout << name << ": "
+              << (uint64_t)(config.packetCount / seconds) << " packets/sec written, "
+              << context.readCount << " read, "
+              << buffer.lostCount() << " lost"
+              << (!valid ? " (SEQUENCE MISMATCH)" : "")
+              << std::endl;
+}
+
+//  Well short of the policy's default shrink window.
+static const uint64_t kSegmentedQuietLength = 1024;
+
+struct SegmentedContext
+{
+    const BenchConfig* config;
+    SegmentedPacketBuffer* buffer;
+    uint64_t checksum;
+    uint32_t maxCapacity;
+};
+
+static void* segmented_producer(void* arg)
+{
+    SegmentedContext* context = reinterpret_cast<SegmentedContext*>(arg);
+    SegmentedPacketBuffer& buffer = *context->buffer;
+    const uint64_t packetCount = context->config->packetCount;
+    const uint64_t burstLength = (uint64_t)context->config->capacity * 64;
+    const uint64_t cycleLength = burstLength + kSegmentedQuietLength;
+
+    for (uint64_t i = 0; i < packetCount; )
+    {
+        bool quiet = (i % cycleLength) >= burstLength;
+        uint64_t remaining = packetCount - i;
+        uint32_t batchSize = quiet ? 1 : context->config->batchSize;
+        if (remaining < batchSize)
+            batchSize = (uint32_t)remaining;
+        PacketSpan span = buffer.reserveWrite(batchSize);
+        if (!span.count)
+        {
+            sched_yield();
+            continue;
+        }
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+            memcpy(span.packets[p].data, &i, sizeof(i));
+        buffer.commitWrite(span.count);
+        context->maxCapacity = std::max(context->maxCapacity, buffer.capacity());
+        if (quiet)
+            sched_yield();
+    }
+    buffer.close();
+    return nullptr;
+}
+
+static void* segmented_consumer(void* arg)
+{
+    SegmentedContext* context = reinterpret_cast<SegmentedContext*>(arg);
+    SegmentedPacketBuffer& buffer = *context->buffer;
+
+    while (buffer.waitForRead())
+    {
+        ConstPacketSpan span = buffer.peekRead(context->config->batchSize);
+        for (uint32_t p = 0; p < span.count; ++p)
+        {
+            uint64_t value;
+            memcpy(&value, span.packets[p].data, sizeof(value));
+            context->checksum += value;
+        }
+        buffer.releaseRead(span.count);
+    }
+    return nullptr;
+}
+
+static void runSegmentedBench(const char* name, const BenchConfig& config)
+{
+    OccupancyResizePolicy policy(config.capacity, config.capacity * 16);
+    SegmentedPacketBuffer buffer(config.packetSize, config.capacity, &policy,
+                                 WaitStrategy::kSpinYield);
+    SegmentedContext context;
+    context.config = &config;
+    context.buffer = &buffer;
+    context.checksum = 0;
+    context.maxCapacity = config.capacity;
+
+    auto start = std::chrono::steady_clock::now();
+
+    pthread_t producerThread, consumerThread;
+    pthread_create(&consumerThread, NULL, segmented_consumer, &context);
+    pthread_create(&producerThread, NULL, segmented_producer, &context);
+    pthread_join(producerThread, NULL);
+    pthread_join(consumerThread, NULL);
+
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t expected = config.packetCount * (config.packetCount - 1) / 2;
+
+    std::cout << name << ": "
+              << (uint64_t)(config.packetCount / seconds) << " packets/sec, "
+              << buffer.resizeCount() << " resizes, capacity up to "
+              << context.maxCapacity << ", ending at " << buffer.capacity()
+              << (context.checksum != expected ? " (CHECKSUM MISMATCH)" : "")
+              << std::endl;
+}
+
+static void runChecksumBench(const char* name, const BenchConfig& config,
+                             uint32_t (*checksum)(uint32_t, const void*, size_t))
+{
+    std::vector<uint8_t> data((size_t)config.packetSize * config.capacity);
+    std::vector<uint8_t> copy(config.packetSize);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (uint8_t)(i * 2654435761u >> 24);
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t result = 0;
+    for (uint64_t i = 0; i < config.packetCount; ++i)
+    {
+        const uint8_t* packet = &data[(i % config.capacity) * config.packetSize];
+        if (checksum)
+        {
+            result ^= checksum(0, packet, config.packetSize);
+        }
+        else
+        {
+            memcpy(copy.data(), packet, config.packetSize);
+            result ^= copy[i % config.packetSize];
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << name << ": "
+              << (uint64_t)(config.packetCount / seconds) << " packets/sec, "
+              << (uint64_t)(config.packetCount * config.packetSize / seconds / (1024*1024))
+              << " MB/sec (" << (result & 1) << ")"
+              << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, const char* argv[])
+{
+    BenchConfig config;
+    config.packetCount = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    config.packetSize = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 64;
+    config.capacity = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 1024;
+    config.batchSize = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 10) : 64;
+    config.threadCount = argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 10) : 4;
+
+    if (config.packetSize < sizeof(uint64_t) || config.capacity < 2 ||
+        !config.batchSize || !config.threadCount)
+    {
+        std::cout << "ringbench [packet count] [packet size >= 8] [capacity >= 2] "
+                     "[batch size] [threads per side]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << config.packetCount << " packets of " << config.packetSize
+              << " bytes, capacity " << config.capacity << std::endl;
+
+    runBench("lockfree", config, lockfree_producer, lockfree_consumer);
+    runBench("batched ", config, batched_producer, batched_consumer);
+    runBench("mutex   ", config, mutex_producer, mutex_consumer);
+    runBench("messages", config, message_producer, message_consumer);
+    runBench("typed   ", config, typed_producer, typed_consumer);
+    runLossyBench("lossy   ", config);
+    runSegmentedBench("segmented", config);
+
+    std::cout << "1 thread, crc32c using " << crc32cImplementation() << std::endl;
+
+    runChecksumBench("crc32c  ", config, crc32c);
+    runChecksumBench("scalar  ", config, crc32cScalar);
+    runChecksumBench("memcpy  ", config, nullptr);
+
+    std::cout << config.threadCount << " producers, "
+              << config.threadCount << " consumers" << std::endl;
+
+    runSharedBench("mpmc    ", config, mpmc_producer, mpmc_consumer);
+    runSharedBench("mutex   ", config, shared_mutex_producer, shared_mutex_consumer);
+
+    std::cout << "1 producer, " << config.threadCount
+              << " broadcast consumers" << std::endl;
+
+    runBroadcastBench("broadcast", config);
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "broadcastpacketbuffer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+BroadcastPacketBuffer::BroadcastPacketBuffer(uint32_t packetDataSize,
+                                             uint32_t packetCapacity,
+                                             uint32_t consumerCount,
+                                             WaitStrategy::Policy waitPolicy) :
+    _packetDataSize(packetDataSize),
+    _packetCapacity(packetCapacity),
+    _mask(packetCapacity > 1 && !(packetCapacity & (packetCapacity - 1)) ?
+          packetCapacity - 1 : 0),
+    _consumerCount(consumerCount ? consumerCount : 1),
+    _byteBuffer((size_t)packetDataSize*packetCapacity, RingStorage::kHeap),
+    _packets(packetCapacity),
+    _cursors(nullptr),
+    _writeSequence(0),
+    _readSequenceCache(0),
+    _readWait(waitPolicy),
+    _writeWait(waitPolicy),
+    _closed(false)
+{
+    uint8_t* packetData = _byteBuffer.data();
+    for(auto& packet : _packets)
+    {
+        packet.data = packetData;
+        packet.size = 0;
+        packetData += packetDataSize;
+    }
+
+    //  std::vector won't align the cursors to a cache line before C++17.
+    void* cursors = nullptr;
+    if (posix_memalign(&cursors, kCacheLineSize, sizeof(Cursor) * _consumerCount))
+        abort();
+    _cursors = reinterpret_cast<Cursor*>(cursors);
+    for (uint32_t i = 0; i < _consumerCount; ++i)
+    {
+        Cursor* cursor = new(&_cursors[i]) Cursor;
+        cursor->readSequence.store(0, std::memory_order_relaxed);
+        cursor->writeSequenceCache = 0;
+    }
+}
+
+BroadcastPacketBuffer::~BroadcastPacketBuffer()
+{
+    for (uint32_t i = 0; i < _consumerCount; ++i)
+    {
+        _cursors[i].~Cursor();
+    }
+    free(_cursors);
+}
+
+void BroadcastPacketBuffer::close()
+{
+    _closed.store(true, std::memory_order_release);
+    _readWait.notify();
+    _writeWait.notify();
+}
+
+//  The slowest Consumer is the one furthest behind the Producer.
+//
+uint64_t BroadcastPacketBuffer::slowestReadSequence() const
+{
+    uint64_t slowest = _writeSequence.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < _consumerCount; ++i)
+    {
+        slowest = std::min(slowest,
+                           _cursors[i].readSequence.load(std::memory_order_acquire));
+    }
+    return slowest;
+}
+
+bool BroadcastPacketBuffer::full() const
+{
+    return _writeSequence.load(std::memory_order_relaxed) -
+           slowestReadSequence() == _packetCapacity;
+}
+
+bool BroadcastPacketBuffer::waitForRead(uint32_t consumer)
+{
+    _readWait.wait([this, consumer]() -> bool {
+        return !empty(consumer) || closed();
+    });
+    return !empty(consumer);
+}
+
+bool BroadcastPacketBuffer::waitForWrite()
+{
+    _writeWait.wait([this]() -> bool { return !full() || closed(); });
+    return !closed();
+}
+
+ConstPacketSpan BroadcastPacketBuffer::peekRead(uint32_t consumer,
+                                                uint32_t maxCount)
+{
+    Cursor& cursor = _cursors[consumer];
+    uint64_t readSequence = cursor.readSequence.load(std::memory_order_relaxed);
+    ConstPacketSpan span = { nullptr, 0, readSequence };
+    uint32_t available = (uint32_t)(cursor.writeSequenceCache - readSequence);
+    if (available < maxCount)
+    {
+        cursor.writeSequenceCache = _writeSequence.load(std::memory_order_acquire);
+        available = (uint32_t)(cursor.writeSequenceCache - readSequence);
+    }
+    uint32_t readIndex = slot(readSequence);
+    span.count = std::min(std::min(available, maxCount), _packetCapacity - readIndex);
+    if (span.count)
+    {
+        span.packets = &_packets[readIndex];
+    }
+    return span;
+}
+
+void BroadcastPacketBuffer::releaseRead(uint32_t consumer, uint32_t count)
+{
+    Cursor& cursor = _cursors[consumer];
+    uint64_t readSequence = cursor.readSequence.load(std::memory_order_relaxed);
+    cursor.readSequence.store(readSequence + count, std::memory_order_release);
+    _writeWait.notify();
+}
+
+PacketSpan BroadcastPacketBuffer::reserveWrite(uint32_t maxCount)
+{
+    uint64_t writeSequence = _writeSequence.load(std::memory_order_relaxed);
+    PacketSpan span = { nullptr, 0, writeSequence };
+    uint32_t available = _packetCapacity - (uint32_t)(writeSequence - _readSequenceCache);
+    if (available < maxCount)
+    {
+        _readSequenceCache = slowestReadSequence();
+        available = _packetCapacity - (uint32_t)(writeSequence - _readSequenceCache);
+    }
+    uint32_t writeIndex = slot(writeSequence);
+    span.count = std::min(std::min(available, maxCount), _packetCapacity - writeIndex);
+    if (span.count)
+    {
+        span.packets = &_packets[writeIndex];
+        for (uint32_t i = 0; i < span.count; ++i)
+            span.packets[i].size = _packetDataSize;
+    }
+    return span;
+}
+
+void BroadcastPacketBuffer::commitWrite(uint32_t count)
+{
+    uint64_t writeSequence = _writeSequence.load(std::memory_order_relaxed);
+    _writeSequence.store(writeSequence + count, std::memory_order_release);
+    _readWait.notify();
+}
@@ -0,0 +1,141 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_BroadcastPacketBuffer_hpp
+#define CK_Sample_BroadcastPacketBuffer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//  A single Producer ring where every Consumer sees every packet.
+//
+//  Each Consumer has its own read cursor, and reads the packets in the
+//  buffer's storage directly - nothing is copied per Consumer.  A packet is
+//  only returned to the Producer once every Consumer has released it, so the
+//  Producer is gated by the slowest Consumer.
+//
+//  The Producer side works as the PacketBuffer's does.  Positions are 64-bit
+//  sequences as in a RingIndex, so all packetCapacity packets are usable and
+//  spans carry the sequence of their first packet.  The Producer caches the
+//  slowest cursor's sequence and only rescans the cursors when that cache
+//  says the buffer is full.  Each cursor sits on its own cache line, so
+//  Consumers advancing at different rates don't contend with each other.
+//
+//  Consumers are identified by an index from 0 to consumerCount - 1, and each
+//  index must only be used by one thread.  Storage is always kHeap - mirrored
+//  descriptors would need every Consumer to refresh the shared mirrors.
+//
+class BroadcastPacketBuffer
+{
+public:
+    BroadcastPacketBuffer(uint32_t packetDataSize, uint32_t packetCapacity,
+                          uint32_t consumerCount,
+                          WaitStrategy::Policy waitPolicy=WaitStrategy::kSpinYield);
+    ~BroadcastPacketBuffer();
+
+    BroadcastPacketBuffer(const BroadcastPacketBuffer&) = delete;
+    BroadcastPacketBuffer& operator=(const BroadcastPacketBuffer&) = delete;
+
+    uint32_t packetDataSize() const { return _packetDataSize; }
+    uint32_t capacity() const { return _packetCapacity; }
+    uint32_t consumerCount() const { return _consumerCount; }
+
+    //  Closes the buffer, releasing the waiting Producer and Consumers.
+    //  Packets already written may still be read.
+    void close();
+    bool closed() const;
+
+    //  Consumer methods
+    bool empty(uint32_t consumer) const;
+    //  Waits until a packet is readable by the consumer.  Returns false if
+    //  the buffer was closed and the consumer has read every packet.
+    bool waitForRead(uint32_t consumer);
+    //  Returns up to maxCount packets unread by the consumer.  The span
+    //  stops at the end of the packet array.
+    ConstPacketSpan peekRead(uint32_t consumer, uint32_t maxCount);
+    //  Marks count packets as read by the consumer.
+    void releaseRead(uint32_t consumer, uint32_t count);
+
+    //  Producer methods
+    //  Waits until a packet is writable (released by every Consumer.)
+    //  Returns false if the buffer was closed.
+    bool waitForWrite();
+    //  As PacketBuffer::reserveWrite and commitWrite.
+    PacketSpan reserveWrite(uint32_t maxCount);
+    void commitWrite(uint32_t count);
+
+private:
+    struct Cursor
+    {
+        //  shared with the Producer
+        alignas(kCacheLineSize) std::atomic<uint64_t> readSequence;
+        uint64_t writeSequenceCache;
+    };
+
+    uint32_t slot(uint64_t sequence) const;
+    uint64_t slowestReadSequence() const;
+    bool full() const;
+
+    const uint32_t _packetDataSize;
+    const uint32_t _packetCapacity;
+    //  capacity - 1 for power of two capacities, zero otherwise.
+    const uint32_t _mask;
+    const uint32_t _consumerCount;
+    RingStorage _byteBuffer;
+    std::vector<Packet> _packets;
+    //  one per Consumer, cache line aligned.
+    Cursor* _cursors;
+
+    //  Producer owned - _writeSequence is shared with the Consumers.
+    alignas(kCacheLineSize) std::atomic<uint64_t> _writeSequence;
+    uint64_t _readSequenceCache;
+
+    //  Waited on by all Consumers, and by the Producer.
+    alignas(kCacheLineSize) WaitStrategy _readWait;
+    alignas(kCacheLineSize) WaitStrategy _writeWait;
+    std::atomic<bool> _closed;
+};
+
+inline bool BroadcastPacketBuffer::closed() const
+{
+    return _closed.load(std::memory_order_acquire);
+}
+
+inline bool BroadcastPacketBuffer::empty(uint32_t consumer) const
+{
+    return _cursors[consumer].readSequence.load(std::memory_order_relaxed) ==
+           _writeSequence.load(std::memory_order_acquire);
+}
+
+inline uint32_t BroadcastPacketBuffer::slot(uint64_t sequence) const
+{
+    return _mask ? (uint32_t)(sequence & _mask)
+                 : (uint32_t)(sequence % _packetCapacity);
+}
+
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "crc32c.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CK_CRC32C_SSE42 1
+#else
+#define CK_CRC32C_SSE42 0
+#endif
+
+//  The reflected Castagnoli polynomial.
+static const uint32_t kPolynomial = 0x82f63b78;
+
+//  Slicing-by-8 tables - table[k][n] is the CRC of byte n followed by k zero
+//  bytes, so eight bytes are folded in with eight independent lookups.
+//
+struct CRC32CTables
+{
+    uint32_t table[8][256];
+
+    CRC32CTables()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t crc = n;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+            table[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            for (int k = 1; k < 8; ++k)
+                table[k][n] = (table[k-1][n] >> 8) ^ table[0][table[k-1][n] & 0xff];
+        }
+    }
+};
+
+static const CRC32CTables& tables()
+{
+    static const CRC32CTables tables;
+    return tables;
+}
+
+uint32_t crc32cScalar(uint32_t crc, const void* data, size_t size)
+{
+    const uint32_t (*table)[256] = tables().table;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+    crc = ~crc;
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        uint32_t low, high;
+        memcpy(&low, bytes, sizeof(low));
+        memcpy(&high, bytes + 4, sizeof(high));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+        crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+              table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+              table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^
+              table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+    }
+    for (; size; --size, ++bytes)
+        crc = (crc >> 8) ^ table[0][(crc ^ *bytes) & 0xff];
+    return ~crc;
+}
+
+#if CK_CRC32C_SSE42
+#if defined(__x86_64__)
+//  Advances a CRC over a fixed run of zero bytes.  The CRC is linear, so the
+//  run's effect on each byte of the CRC is tabulated from its effect on each
+//  bit, and applying it costs four lookups.
+//
+struct CRC32CShift
+{
+    uint32_t table[4][256];
+
+    CRC32CShift(size_t zeroCount)
+    {
+        const uint32_t* byteTable = tables().table[0];
+        uint32_t bits[32];
+        for (int bit = 0; bit < 32; ++bit)
+        {
+            uint32_t crc = 1u << bit;
+            for (size_t i = 0; i < zeroCount; ++i)
+                crc = (crc >> 8) ^ byteTable[crc & 0xff];
+            bits[bit] = crc;
+        }
+        for (int k = 0; k < 4; ++k)
+        {
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t crc = 0;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    if (n & (1u << bit))
+                        crc ^= bits[k * 8 + bit];
+                }
+                table[k][n] = crc;
+            }
+        }
+    }
+
+    uint32_t operator()(uint32_t crc) const
+    {
+        return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+               table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+    }
+};
+
+//  The crc32 instruction has a latency of three cycles but can start every
+//  cycle, so large buffers are split into three lanes checksummed together,
+//  with the lanes' CRCs combined at the end of each block.
+static const size_t kLaneSize = 1024;
+#endif
+
+//  Compiled for SSE4.2 regardless of the build's target, and only called
+//  once the CPU is known to support it.
+//
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSSE42(uint32_t crc, const void* data, size_t size)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (size >= kLaneSize * 3)
+    {
+        static const CRC32CShift shiftLane(kLaneSize);
+        static const CRC32CShift shiftTwoLanes(kLaneSize * 2);
+        for (; size >= kLaneSize * 3; size -= kLaneSize * 3, bytes += kLaneSize * 3)
+        {
+            uint64_t crcA = crc, crcB = 0, crcC = 0;
+            for (size_t offset = 0; offset < kLaneSize; offset += 8)
+            {
+                uint64_t a, b, c;
+                memcpy(&a, bytes + offset, sizeof(a));
+                memcpy(&b, bytes + kLaneSize + offset, sizeof(b));
+                memcpy(&c, bytes + kLaneSize * 2 + offset, sizeof(c));
+                crcA = _mm_crc32_u64(crcA, a);
+                crcB = _mm_crc32_u64(crcB, b);
+                crcC = _mm_crc32_u64(crcC, c);
+            }
+            crc = shiftTwoLanes((uint32_t)crcA) ^ shiftLane((uint32_t)crcB) ^
+                  (uint32_t)crcC;
+        }
+    }
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        uint64_t value;
+        memcpy(&value, bytes, sizeof(value));
+        crc64 = _mm_crc32_u64(crc64, value);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for (; size >= 4; size -= 4, bytes += 4)
+    {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        crc = _mm_crc32_u32(crc, value);
+    }
+    for (; size; --size, ++bytes)
+        crc = _mm_crc32_u8(crc, *bytes);
+    return ~crc;
+}
+#endif
+
+typedef uint32_t (*CRC32CFunction)(uint32_t, const void*, size_t);
+
+struct CRC32CDispatch
+{
+    CRC32CFunction function;
+    const char* name;
+
+    CRC32CDispatch() :
+        function(crc32cScalar),
+        name("scalar")
+    {
+#if CK_CRC32C_SSE42
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            function = crc32cSSE42;
+            name = "sse4.2";
+        }
+#endif
+    }
+};
+
+static const CRC32CDispatch& dispatch()
+{
+    static const CRC32CDispatch dispatch;
+    return dispatch;
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t size)
+{
+    return dispatch().function(crc, data, size);
+}
+
+const char* crc32cImplementation()
+{
+    return dispatch().name;
+}
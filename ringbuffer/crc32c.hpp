@@ -0,0 +1,47 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_CRC32C_hpp
+#define CK_Sample_CRC32C_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+//  CRC-32C (Castagnoli), as used by iSCSI, ext4 and SCTP.
+//
+//  crc32c uses the SSE4.2 crc32 instruction where the CPU has it (checked
+//  once, at the first call), and a table driven slicing-by-8 implementation
+//  otherwise.  Pass 0 to start a checksum, or a previous result to continue
+//  one over more data.
+//
+uint32_t crc32c(uint32_t crc, const void* data, size_t size);
+
+//  The portable implementation, whatever the CPU.
+uint32_t crc32cScalar(uint32_t crc, const void* data, size_t size);
+
+//  The name of the implementation crc32c dispatches to.
+const char* crc32cImplementation();
+
+
+#endif
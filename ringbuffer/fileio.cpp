@@ -0,0 +1,289 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "fileio.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <limits.h>
+#include <sys/uio.h>
+
+//  Requests are tagged with a sequence number - the nth packet read from (or
+//  written to) the file.  Per packet state lives at sequence % capacity,
+//  which is unique among the packets between the head and the last queued
+//  packet.
+//
+static const uint32_t kMaxCompletions = 64;
+
+FileInput::FileInput(int fd, uint32_t queueDepth) :
+    _ioQueue(queueDepth),
+    _fd(fd)
+{
+}
+
+int FileInput::produce(PacketBuffer& buffer)
+{
+    RingStorage& storage = buffer.storage();
+    _ioQueue.registerBuffer(storage.data(), storage.size());
+
+    //  bytes read per packet, or -1 while the read is in flight.
+    std::vector<int32_t> results(buffer.capacity(), -1);
+    uint64_t headSequence = 0;          // next packet to commit
+    uint64_t tailSequence = 0;          // next packet to queue
+    bool endOfInput = false;
+    int error = 0;
+
+    for (;;)
+    {
+        if (buffer.closed())
+            endOfInput = true;
+
+        //  the packets already in flight are at the start of the span - the
+        //  write head doesn't move until they're committed.
+        PacketSpan writeTo = buffer.reserveWrite(UINT32_MAX);
+        uint32_t queued = (uint32_t)(tailSequence - headSequence);
+        while (!endOfInput && queued < writeTo.count && !_ioQueue.full())
+        {
+            Packet& packet = writeTo.packets[queued];
+            uint64_t offset = tailSequence * buffer.packetDataSize();
+            results[tailSequence % results.size()] = -1;
+            _ioQueue.queueRead(_fd, packet.data, buffer.packetDataSize(),
+                               offset, tailSequence);
+            ++tailSequence;
+            ++queued;
+        }
+
+        if (!_ioQueue.pending())
+        {
+            if (endOfInput)
+                break;
+            //  every free packet is committed - wait on the reader.
+            if (!buffer.waitForWrite())
+                endOfInput = true;
+            continue;
+        }
+
+        IOQueue::Completion completions[kMaxCompletions];
+        uint32_t count = _ioQueue.complete(completions, kMaxCompletions, true);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            int32_t result = completions[i].result;
+            if (result < 0)
+            {
+                error = -result;
+                endOfInput = true;
+                result = 0;
+            }
+            results[completions[i].userData % results.size()] = result;
+        }
+
+        //  commit the completed reads at the write head, stopping at the end
+        //  of the file.  Reads queued past the end complete with zero bytes
+        //  and are dropped.
+        uint32_t commitCount = 0;
+        while (headSequence + commitCount < tailSequence && !error)
+        {
+            int32_t result = results[(headSequence + commitCount) % results.size()];
+            if (result < 0)
+                break;
+            if (result > 0)
+            {
+                writeTo.packets[commitCount].size = (uint32_t)result;
+                ++commitCount;
+            }
+            if (result < (int32_t)buffer.packetDataSize())
+            {
+                endOfInput = true;
+                break;
+            }
+        }
+        if (commitCount)
+        {
+            buffer.commitWrite(commitCount);
+            headSequence += commitCount;
+        }
+        if (endOfInput)
+        {
+            //  nothing queued past this point will be committed.
+            headSequence = tailSequence;
+        }
+    }
+    return error;
+}
+
+FileOutput::FileOutput(int fd, uint32_t queueDepth) :
+    _ioQueue(queueDepth),
+    _fd(fd)
+{
+}
+
+int FileOutput::consume(PacketBuffer& buffer)
+{
+    RingStorage& storage = buffer.storage();
+    _ioQueue.registerBuffer(storage.data(), storage.size());
+
+    struct WriteState
+    {
+        uint64_t offset;
+        uint32_t written;
+    };
+    std::vector<WriteState> writes(buffer.capacity());
+    uint64_t headSequence = 0;          // next packet to release
+    uint64_t tailSequence = 0;          // next packet to queue
+    uint64_t fileOffset = 0;
+    int error = 0;
+
+    for (;;)
+    {
+        //  the packets in flight are at the start of the span - the read
+        //  head doesn't move until they're released.
+        ConstPacketSpan readFrom = buffer.peekRead(UINT32_MAX);
+        uint32_t queued = (uint32_t)(tailSequence - headSequence);
+        while (!error && queued < readFrom.count && !_ioQueue.full())
+        {
+            const Packet& packet = readFrom.packets[queued];
+            WriteState& state = writes[tailSequence % writes.size()];
+            state.offset = fileOffset;
+            state.written = 0;
+            _ioQueue.queueWrite(_fd, packet.data, packet.size, fileOffset,
+                                tailSequence);
+            fileOffset += packet.size;
+            ++tailSequence;
+            ++queued;
+        }
+
+        if (!_ioQueue.pending())
+        {
+            if (error)
+                break;
+            //  returns false once the buffer is flushed and input is done
+            if (!buffer.waitForRead())
+                break;
+            continue;
+        }
+
+        IOQueue::Completion completions[kMaxCompletions];
+        uint32_t count = _ioQueue.complete(completions, kMaxCompletions, true);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint64_t sequence = completions[i].userData;
+            int32_t result = completions[i].result;
+            if (result <= 0)
+            {
+                error = result < 0 ? -result : 2;
+                continue;
+            }
+            WriteState& state = writes[sequence % writes.size()];
+            const Packet& packet = readFrom.packets[sequence - headSequence];
+            state.written += (uint32_t)result;
+            if (state.written < packet.size && !error)
+            {
+                _ioQueue.queueWrite(_fd, packet.data + state.written,
+                                    packet.size - state.written,
+                                    state.offset + state.written, sequence);
+            }
+        }
+
+        uint32_t releaseCount = 0;
+        size_t releaseBytes = 0;
+        while (headSequence + releaseCount < tailSequence)
+        {
+            const Packet& packet = readFrom.packets[releaseCount];
+            if (writes[(headSequence + releaseCount) % writes.size()].written < packet.size)
+                break;
+            releaseBytes += packet.size;
+            ++releaseCount;
+        }
+        if (releaseCount)
+        {
+            buffer.releaseRead(releaseCount);
+            headSequence += releaseCount;
+            addOutputCount(releaseBytes);
+        }
+    }
+    return error;
+}
+
+int GatherOutput::consume(PacketBuffer& buffer)
+{
+    const uint32_t maxVectors = std::min<uint32_t>(IOV_MAX, buffer.capacity());
+    std::vector<iovec> vectors(maxVectors);
+
+    //  returns false once the buffer is flushed and input is done
+    while (buffer.waitForRead())
+    {
+        uint32_t packetCount = 0;
+        size_t byteCount = 0;
+        while (packetCount < maxVectors)
+        {
+            ConstPacketSpan span = buffer.peekRead(maxVectors - packetCount,
+                                                   packetCount);
+            if (!span.count)
+                break;
+            for (uint32_t i = 0; i < span.count; ++i)
+            {
+                iovec& vector = vectors[packetCount + i];
+                vector.iov_base = span.packets[i].data;
+                vector.iov_len = span.packets[i].size;
+                byteCount += span.packets[i].size;
+            }
+            packetCount += span.count;
+        }
+
+        //  writev may write less than asked, so step through the vectors
+        //  until everything is out.
+        iovec* vector = vectors.data();
+        uint32_t vectorCount = packetCount;
+        size_t remaining = byteCount;
+        while (remaining)
+        {
+            ssize_t written = writev(_fd, vector, (int)vectorCount);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return errno;
+            }
+            if (!written)
+                return 2;
+            remaining -= (size_t)written;
+            while (vectorCount && (size_t)written >= vector->iov_len)
+            {
+                written -= vector->iov_len;
+                ++vector;
+                --vectorCount;
+            }
+            if (vectorCount)
+            {
+                vector->iov_base = (uint8_t*)vector->iov_base + written;
+                vector->iov_len -= (size_t)written;
+            }
+        }
+
+        buffer.releaseRead(packetCount);
+        addOutputCount(byteCount);
+    }
+    return 0;
+}
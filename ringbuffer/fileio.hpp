@@ -0,0 +1,98 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_FileIO_hpp
+#define CK_Sample_FileIO_hpp
+
+#include "streamer.hpp"
+#include "ioqueue.hpp"
+
+#include <vector>
+
+//  Reads a file directly into the buffer's packets through an IOQueue.
+//
+//  Reads are queued into every free packet (up to the queue depth), each
+//  packet read from its own offset in the file, so that several reads are in
+//  flight at once.  Reads may complete in any order, but packets are
+//  committed to the Consumer in file order as the reads at the write head
+//  complete.  The first short read marks the end of the file.
+//
+//  The buffer's storage is registered with the queue, so reads go straight
+//  into the ring without a copy through an intermediate buffer.  The file
+//  must be seekable (reads are positioned.)
+//
+class FileInput : public StreamInput
+{
+public:
+    FileInput(int fd, uint32_t queueDepth);
+
+    //  False if the queue fell back to preadv.
+    bool asynchronous() const { return _ioQueue.asynchronous(); }
+
+    int produce(PacketBuffer& buffer) override;
+
+private:
+    IOQueue _ioQueue;
+    int _fd;
+};
+
+//  Writes the buffer's packets to a file through an IOQueue.
+//
+//  As with the FileInput, writes are queued for every readable packet (up to
+//  the queue depth), and packets are released to the Producer in order as
+//  the writes at the read head complete.  Short writes are requeued for the
+//  remainder of the packet.
+//
+class FileOutput : public StreamOutput
+{
+public:
+    FileOutput(int fd, uint32_t queueDepth);
+
+    int consume(PacketBuffer& buffer) override;
+
+private:
+    IOQueue _ioQueue;
+    int _fd;
+};
+
+//  Writes every readable packet to a file (or pipe, or socket) with a single
+//  writev call, then releases them all at once.
+//
+//  When the Consumer falls behind, the backlog goes out in one system call
+//  per IOV_MAX packets rather than one call per packet.  Packets that wrap
+//  past the end of the packet array are gathered with a second peek.
+//
+class GatherOutput : public StreamOutput
+{
+public:
+    GatherOutput(int fd) : _fd(fd) {}
+
+    int consume(PacketBuffer& buffer) override;
+
+private:
+    int _fd;
+};
+
+
+#endif
@@ -0,0 +1,262 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ioqueue.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CK_IOQUEUE_URING 1
+#endif
+#endif
+
+#if CK_IOQUEUE_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+IOQueue::IOQueue(uint32_t queueDepth) :
+    _queueDepth(queueDepth ? queueDepth : 1),
+    _pending(0),
+    _unsubmitted(0),
+    _ringFd(-1),
+    _ringMemory(nullptr),
+    _ringMemorySize(0),
+    _sqeMemory(nullptr),
+    _sqeMemorySize(0),
+    _sqHead(nullptr),
+    _sqTail(nullptr),
+    _sqMask(0),
+    _sqArray(nullptr),
+    _cqHead(nullptr),
+    _cqTail(nullptr),
+    _cqMask(0),
+    _cqes(nullptr),
+    _registeredData(nullptr),
+    _registeredSize(0)
+{
+    if (!setupRing())
+    {
+        _completed.reserve(_queueDepth);
+    }
+}
+
+IOQueue::~IOQueue()
+{
+#if CK_IOQUEUE_URING
+    if (_sqeMemory)
+        munmap(_sqeMemory, _sqeMemorySize);
+    if (_ringMemory)
+        munmap(_ringMemory, _ringMemorySize);
+    if (_ringFd >= 0)
+        close(_ringFd);
+#endif
+}
+
+//  Maps the submission and completion rings shared with the kernel.  The
+//  kernel may round the ring sizes up, but we never keep more than
+//  queueDepth requests pending, so neither ring can overflow.
+//
+bool IOQueue::setupRing()
+{
+#if CK_IOQUEUE_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, _queueDepth, &params);
+    if (fd < 0)
+        return false;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    _ringMemorySize = sqSize > cqSize ? sqSize : cqSize;
+    _ringMemory = mmap(NULL, _ringMemorySize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (_ringMemory == MAP_FAILED)
+    {
+        _ringMemory = nullptr;
+        close(fd);
+        return false;
+    }
+    _sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+    _sqeMemory = mmap(NULL, _sqeMemorySize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (_sqeMemory == MAP_FAILED)
+    {
+        _sqeMemory = nullptr;
+        munmap(_ringMemory, _ringMemorySize);
+        _ringMemory = nullptr;
+        close(fd);
+        return false;
+    }
+
+    uint8_t* ring = (uint8_t*)_ringMemory;
+    _sqHead = (uint32_t*)(ring + params.sq_off.head);
+    _sqTail = (uint32_t*)(ring + params.sq_off.tail);
+    _sqMask = *(uint32_t*)(ring + params.sq_off.ring_mask);
+    _sqArray = (uint32_t*)(ring + params.sq_off.array);
+    _cqHead = (uint32_t*)(ring + params.cq_off.head);
+    _cqTail = (uint32_t*)(ring + params.cq_off.tail);
+    _cqMask = *(uint32_t*)(ring + params.cq_off.ring_mask);
+    _cqes = ring + params.cq_off.cqes;
+    _ringFd = fd;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IOQueue::registerBuffer(uint8_t* data, size_t size)
+{
+#if CK_IOQUEUE_URING
+    if (_ringFd < 0 || _registeredData)
+        return false;
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = size;
+    if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS,
+                &iov, 1) < 0)
+        return false;
+    _registeredData = data;
+    _registeredSize = size;
+    return true;
+#else
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+bool IOQueue::queueRead(int fd, uint8_t* data, uint32_t size, uint64_t offset,
+                        uint64_t userData)
+{
+    return queueRequest(false, fd, data, size, offset, userData);
+}
+
+bool IOQueue::queueWrite(int fd, const uint8_t* data, uint32_t size,
+                         uint64_t offset, uint64_t userData)
+{
+    return queueRequest(true, fd, const_cast<uint8_t*>(data), size, offset,
+                        userData);
+}
+
+bool IOQueue::queueRequest(bool write, int fd, uint8_t* data, uint32_t size,
+                           uint64_t offset, uint64_t userData)
+{
+    if (full())
+        return false;
+    ++_pending;
+
+#if CK_IOQUEUE_URING
+    if (_ringFd >= 0)
+    {
+        uint32_t tail = *_sqTail;
+        uint32_t index = tail & _sqMask;
+        io_uring_sqe* sqe = (io_uring_sqe*)_sqeMemory + index;
+        memset(sqe, 0, sizeof(*sqe));
+        bool fixed = _registeredData && data >= _registeredData &&
+                     data + size <= _registeredData + _registeredSize;
+        if (fixed)
+            sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        else
+            sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->off = offset;
+        sqe->addr = (uint64_t)(uintptr_t)data;
+        sqe->len = size;
+        sqe->buf_index = 0;
+        sqe->user_data = userData;
+        _sqArray[index] = index;
+        __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++_unsubmitted;
+        return true;
+    }
+#endif
+
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = size;
+    ssize_t result = write ? pwritev(fd, &iov, 1, (off_t)offset)
+                           : preadv(fd, &iov, 1, (off_t)offset);
+    Completion completion;
+    completion.userData = userData;
+    completion.result = result < 0 ? -errno : (int32_t)result;
+    _completed.push_back(completion);
+    return true;
+}
+
+uint32_t IOQueue::complete(Completion* completions, uint32_t maxCount,
+                           bool wait)
+{
+    uint32_t count = 0;
+
+#if CK_IOQUEUE_URING
+    if (_ringFd >= 0)
+    {
+        uint32_t head = *_cqHead;
+        bool ready = head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        uint32_t minComplete = (wait && !ready && _pending) ? 1 : 0;
+        if (_unsubmitted || minComplete)
+        {
+            int res = (int)syscall(__NR_io_uring_enter, _ringFd, _unsubmitted,
+                            minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0,
+                            NULL, 0);
+            if (res >= 0)
+                _unsubmitted -= (uint32_t)res;
+        }
+        uint32_t tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail && count < maxCount)
+        {
+            const io_uring_cqe* cqe = (const io_uring_cqe*)_cqes + (head & _cqMask);
+            completions[count].userData = cqe->user_data;
+            completions[count].result = cqe->res;
+            ++count;
+            ++head;
+        }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        _pending -= count;
+        return count;
+    }
+#endif
+
+    (void)wait;
+    while (count < maxCount && count < _completed.size())
+    {
+        completions[count] = _completed[count];
+        ++count;
+    }
+    _completed.erase(_completed.begin(), _completed.begin() + count);
+    _pending -= count;
+    return count;
+}
@@ -0,0 +1,114 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_IOQueue_hpp
+#define CK_Sample_IOQueue_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//  A queue of asynchronous file reads and writes.
+//
+//  On Linux the queue is an io_uring, which keeps up to queueDepth requests
+//  in flight with one system call per batch of submissions.  Memory
+//  registered with registerBuffer is pinned by the kernel once, and reads or
+//  writes within it skip the per-request page mapping.
+//
+//  Where io_uring isn't available (older kernels, restricted containers or
+//  other platforms) the queue falls back to performing each request with
+//  preadv/pwritev as it's queued, reporting it complete immediately.
+//
+//  Not thread safe - a queue is meant to be owned by a single thread.
+//
+class IOQueue
+{
+public:
+    struct Completion
+    {
+        uint64_t userData;
+        int32_t result;         //  bytes transferred, or -errno
+    };
+
+    IOQueue(uint32_t queueDepth);
+    ~IOQueue();
+
+    IOQueue(const IOQueue&) = delete;
+    IOQueue& operator=(const IOQueue&) = delete;
+
+    //  True if requests are queued through io_uring.
+    bool asynchronous() const { return _ringFd >= 0; }
+    //  Number of requests queued or in flight.
+    uint32_t pending() const { return _pending; }
+    //  True if another request can be queued.
+    bool full() const { return _pending >= _queueDepth; }
+
+    //  Registers a single memory region for fixed buffer reads and writes.
+    //  Returns false if registration failed (requests will still work.)
+    bool registerBuffer(uint8_t* data, size_t size);
+
+    //  Queues a request.  Returns false if the queue is full.
+    bool queueRead(int fd, uint8_t* data, uint32_t size, uint64_t offset,
+                   uint64_t userData);
+    bool queueWrite(int fd, const uint8_t* data, uint32_t size, uint64_t offset,
+                    uint64_t userData);
+
+    //  Submits queued requests, then returns up to maxCount completed
+    //  requests.  If wait is true, blocks until at least one request
+    //  completes (unless nothing is pending.)
+    uint32_t complete(Completion* completions, uint32_t maxCount, bool wait);
+
+private:
+    bool setupRing();
+    bool queueRequest(bool write, int fd, uint8_t* data, uint32_t size,
+                      uint64_t offset, uint64_t userData);
+
+    const uint32_t _queueDepth;
+    uint32_t _pending;
+    uint32_t _unsubmitted;
+
+    int _ringFd;
+    void* _ringMemory;
+    size_t _ringMemorySize;
+    void* _sqeMemory;
+    size_t _sqeMemorySize;
+
+    uint32_t* _sqHead;
+    uint32_t* _sqTail;
+    uint32_t _sqMask;
+    uint32_t* _sqArray;
+    uint32_t* _cqHead;
+    uint32_t* _cqTail;
+    uint32_t _cqMask;
+    void* _cqes;
+
+    const uint8_t* _registeredData;
+    size_t _registeredSize;
+
+    //  completions from the preadv/pwritev fallback
+    std::vector<Completion> _completed;
+};
+
+
+#endif
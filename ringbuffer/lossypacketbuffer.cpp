@@ -0,0 +1,152 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "lossypacketbuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+LossyPacketBuffer::LossyPacketBuffer(uint32_t packetDataSize,
+                                     uint32_t packetCapacity,
+                                     WaitStrategy::Policy waitPolicy) :
+    _packetDataSize(packetDataSize),
+    _byteBuffer((size_t)packetDataSize*packetCapacity, RingStorage::kHeap),
+    _slots(packetCapacity),
+    _writeSequence(0),
+    _readSequence(0),
+    _lostCount(0),
+    _readWait(waitPolicy),
+    _closed(false)
+{
+    uint8_t* packetData = _byteBuffer.data();
+    for (auto& slot : _slots)
+    {
+        slot.sequence.store(0, std::memory_order_relaxed);
+        slot.size.store(0, std::memory_order_relaxed);
+        slot.data = packetData;
+        packetData += packetDataSize;
+    }
+    _writePacket.data = nullptr;
+    _writePacket.size = 0;
+}
+
+void LossyPacketBuffer::close()
+{
+    _closed.store(true, std::memory_order_release);
+    _readWait.notify();
+}
+
+bool LossyPacketBuffer::waitForRead()
+{
+    _readWait.wait([this]() -> bool { return !empty() || closed(); });
+    return !empty();
+}
+
+//  Marks the slot as being written before any of its data changes, so a
+//  Consumer copying the slot's previous packet sees the sequence change.
+//
+Packet* LossyPacketBuffer::writeHead()
+{
+    uint64_t sequence = _writeSequence.load(std::memory_order_relaxed);
+    Slot& slot = slotAt(sequence);
+    slot.sequence.store(writingSequence(sequence), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _writePacket.data = slot.data;
+    _writePacket.size = _packetDataSize;
+    return &_writePacket;
+}
+
+void LossyPacketBuffer::advanceWrite()
+{
+    uint64_t sequence = _writeSequence.load(std::memory_order_relaxed);
+    Slot& slot = slotAt(sequence);
+    slot.size.store(_writePacket.size, std::memory_order_relaxed);
+    slot.sequence.store(writtenSequence(sequence), std::memory_order_release);
+    _writeSequence.store(sequence + 1, std::memory_order_release);
+    _readWait.notify();
+}
+
+//  Called when the Producer has lapped the slot being read.  The Consumer is
+//  then reading the slots the Producer overwrites next, and stepping to the
+//  following slot would leave it trailing the Producer, losing one packet per
+//  read.  Instead skip ahead to half a ring behind the write head, counting
+//  every packet skipped as lost.
+//
+void LossyPacketBuffer::resyncRead()
+{
+    uint64_t writeSequence = _writeSequence.load(std::memory_order_acquire);
+    uint64_t margin = std::max<uint64_t>(_slots.size() / 2, 1);
+    uint64_t target = writeSequence - std::min(margin, writeSequence);
+    if (target <= _readSequence)
+        target = _readSequence + 1;
+    _lostCount += target - _readSequence;
+    _readSequence = target;
+}
+
+bool LossyPacketBuffer::read(uint8_t* data, uint32_t maxSize, uint32_t* size,
+                             uint64_t* lost)
+{
+    uint64_t lostBefore = _lostCount;
+    for (;;)
+    {
+        uint64_t writeSequence = _writeSequence.load(std::memory_order_acquire);
+        if (_readSequence == writeSequence)
+            return false;
+
+        //  more than a ring behind - skip to the oldest packet that may
+        //  still be intact.
+        if (writeSequence - _readSequence > _slots.size())
+        {
+            uint64_t oldest = writeSequence - _slots.size();
+            _lostCount += oldest - _readSequence;
+            _readSequence = oldest;
+        }
+
+        Slot& slot = slotAt(_readSequence);
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != writtenSequence(_readSequence))
+        {
+            //  the Producer has started on the next lap of this slot.
+            resyncRead();
+            continue;
+        }
+
+        uint32_t packetSize = slot.size.load(std::memory_order_relaxed);
+        memcpy(data, slot.data, std::min(packetSize, maxSize));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+        if (after != before)
+        {
+            //  overwritten while we copied it.
+            resyncRead();
+            continue;
+        }
+        ++_readSequence;
+
+        *size = packetSize;
+        *lost = _lostCount - lostBefore;
+        return true;
+    }
+}
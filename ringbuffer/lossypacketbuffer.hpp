@@ -0,0 +1,141 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_LossyPacketBuffer_hpp
+#define CK_Sample_LossyPacketBuffer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//  A single Producer, single Consumer ring that never blocks the Producer.
+//
+//  When the ring is full, the Producer overwrites the oldest packet instead
+//  of waiting for the Consumer - for telemetry and trace streams, where
+//  dropping old data is better than stalling the thread producing it.
+//
+//  Every packet gets a sequence number, and each slot records the sequence
+//  of the packet it holds as a seqlock: odd while the Producer is writing
+//  the slot, even once the write is complete.  The Consumer copies a packet
+//  out of its slot and then checks the slot's sequence again - if the
+//  Producer lapped it mid-copy, the copy is discarded.  A Consumer that falls
+//  more than a ring behind skips to the oldest packet, and one that finds
+//  its packet lapped skips ahead to half a ring behind the Producer.  It
+//  counts every packet it missed and reports them with the next packet it
+//  reads.
+//
+//  Neither side takes a lock, and nothing the Consumer does can make the
+//  Producer wait.  Since a packet may be overwritten at any time, the
+//  Consumer always reads a copy rather than the slot itself.
+//
+class LossyPacketBuffer
+{
+public:
+    LossyPacketBuffer(uint32_t packetDataSize, uint32_t packetCapacity,
+                      WaitStrategy::Policy waitPolicy=WaitStrategy::kSpinYield);
+
+    uint32_t packetDataSize() const { return _packetDataSize; }
+    uint32_t capacity() const { return (uint32_t)_slots.size(); }
+
+    bool empty() const;
+
+    //  Closes the buffer, releasing a waiting Consumer.
+    void close();
+    bool closed() const;
+
+    //  Consumer methods
+    //  Waits until a packet is readable.  Returns false if the buffer was
+    //  closed and has no packets left to read.
+    bool waitForRead();
+    //  Copies the oldest unread packet into data (up to maxSize bytes),
+    //  returning the packet's size in size.  lost is set to the number of
+    //  packets overwritten since the previous read.  Returns false if there
+    //  was nothing to read.
+    bool read(uint8_t* data, uint32_t maxSize, uint32_t* size, uint64_t* lost);
+    //  The sequence number of the next packet to read, and the total number
+    //  of packets lost so far.
+    uint64_t readSequence() const { return _readSequence; }
+    uint64_t lostCount() const { return _lostCount; }
+
+    //  Producer methods - these never wait.
+    //  Returns the next packet to write, sized to the packet data size.  The
+    //  slot's previous contents are lost to the Consumer if unread.
+    Packet* writeHead();
+    //  Publishes the packet returned by writeHead.
+    void advanceWrite();
+    //  The sequence number of the next packet written.
+    uint64_t writeSequence() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint32_t> size;
+        uint8_t* data;
+    };
+
+    Slot& slotAt(uint64_t sequence);
+    void resyncRead();
+    static uint64_t writingSequence(uint64_t sequence) { return sequence * 2 + 1; }
+    static uint64_t writtenSequence(uint64_t sequence) { return sequence * 2 + 2; }
+
+    const uint32_t _packetDataSize;
+    RingStorage _byteBuffer;
+    std::vector<Slot> _slots;
+
+    //  Producer owned - _writeSequence is shared with the Consumer.
+    alignas(kCacheLineSize) std::atomic<uint64_t> _writeSequence;
+    Packet _writePacket;
+    //  Consumer owned.
+    alignas(kCacheLineSize) uint64_t _readSequence;
+    uint64_t _lostCount;
+
+    alignas(kCacheLineSize) WaitStrategy _readWait;
+    std::atomic<bool> _closed;
+};
+
+inline bool LossyPacketBuffer::empty() const
+{
+    return _readSequence == _writeSequence.load(std::memory_order_acquire);
+}
+
+inline bool LossyPacketBuffer::closed() const
+{
+    return _closed.load(std::memory_order_acquire);
+}
+
+inline uint64_t LossyPacketBuffer::writeSequence() const
+{
+    return _writeSequence.load(std::memory_order_acquire);
+}
+
+inline auto LossyPacketBuffer::slotAt(uint64_t sequence) -> Slot&
+{
+    return _slots[sequence % _slots.size()];
+}
+
+
+#endif
@@ -22,266 +22,309 @@
  * THE SOFTWARE. 
  */
 
-#include "packetbuffer.hpp"
-
+#include "crc32c.hpp"
+#include "fileio.hpp"
+#include "mappedio.hpp"
+#include "pipeline.hpp"
+#include "streambufio.hpp"
+
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
-#include <pthread.h>
+#include <fcntl.h>
 #include <unistd.h>
 
+//  A sample pipeline stage - XORs every byte with a key.  Two stages with
+//  the same key leave the stream unchanged.
 //
-//  The Stream manages sync between a Reader and Writer threads, and their
-//  common RingBuffer.
-//
-class Streamer
+class XorStage : public PipelineStage
 {
 public:
-    Streamer(std::streambuf& in, std::streambuf& out, uint32_t bufferCapacity);
-    ~Streamer();
-    
-    operator bool() const
-    {
-        return true;
-    }
+    XorStage(uint8_t key) : _key(key) {}
 
-    bool active() const {
-        return inputActive() || outputActive(); 
-    }
-
-    bool inputActive() const {
-        return _inputActive;
-    }
-    bool outputActive() const {
-        return _outputActive;
-    }
-
-    size_t outputCount() const {
-        return _outputCount;
+    int transform(const Packet& input, Packet* output) override
+    {
+        for (uint32_t i = 0; i < input.size; ++i)
+            output->data[i] = input.data[i] ^ _key;
+        output->size = input.size;
+        return 0;
     }
 
 private:
-    static void* writer_thread(void* arg);
-    static void* reader_thread(void* arg);
-
-private:
-    std::streambuf& _infile;
-    std::streambuf& _outfile;
-
-    volatile size_t _outputCount;
-    volatile bool _inputActive;
-    volatile bool _outputActive;
-    volatile bool _terminateStream;
-
-    PacketBuffer _buffer;
-    pthread_t _writerThread;
-    pthread_t _readerThread;
-    pthread_mutex_t _writerMutex;
-    pthread_cond_t _writerCond;
+    uint8_t _key;
 };
 
+///////////////////////////////////////////////////////////////////////////////
 
-//  Our writer thread reads from the input file stream and populates our
-//  ring buffer's write section.  If the write buffer fills up, it will wait
-//  for the reader thread to process data before writing new data into the
-//  buffer from our input stream
-//
-void* Streamer::writer_thread(void* arg)
+template<typename Stream> static void runStream(Stream& stream)
 {
-    Streamer* stream = reinterpret_cast<Streamer*>(arg);
-    std::streambuf& infile = stream->_infile;
-    PacketBuffer& buffer = stream->_buffer;
-    intptr_t result = 0;
-    
-    while (!stream->_terminateStream)
+    uint32_t frame = 0;
+
+    while (stream.active())
     {
-        Packet* writeTo = buffer.writeHead();
-        if (!writeTo)
-        {
-            result = 1;
-            break;
-        }
-        std::streamsize sz = infile.sgetn((char*)writeTo->data, writeTo->size);
-        if (!sz)
-        {
-            result = 2;
-            break;
-        }
-        writeTo->size = sz;
-      
-        pthread_mutex_lock(&stream->_writerMutex);
-        while (!buffer.advanceWrite() && stream->outputActive())
+        if (!(frame % 60))
         {
-        //    std::cout << "W" << std::flush;
-            pthread_cond_wait(&stream->_writerCond, &stream->_writerMutex);
+            std::cout << "Output " << stream.outputCount() << " bytes..."
+                      << std::endl << std::flush;
         }
-        //std::cout << "i" << std::flush;
-        pthread_mutex_unlock(&stream->_writerMutex);
-        if (!stream->outputActive())
-            break;
+        usleep(16666);          // approximate 60hz (60 fps)
+        ++frame;
     }
-
-    stream->_inputActive = false;
-
-    std::cout << "writer terminated : " << result << std::endl << std::flush;
-
-    return (void*)result;
 }
 
-//  Our reader thread acquires data from our buffer's read section and
-//  outputs that data to our output file
-//
-//  Note - this thread uses usleeps to simulate a "slower" serialized
-//  output device that runs at approximately 48khz (i.e. a sound mixer.)
-//  This delay would normally allow our writer and main threads to run
-//  while the reader processes data.
-//  
-//  An alternative to this approach might be to use another condition
-//  variable, where the writer signals the reader when it has data ready
-//  for processing
-//  
-void* Streamer::reader_thread(void* arg)
+static void printPacedStats(const PacedOutput::Stats& stats, uint32_t capacity)
 {
-    Streamer* stream = reinterpret_cast<Streamer*>(arg);
-    std::streambuf& outfile = stream->_outfile;
-    PacketBuffer& buffer = stream->_buffer;
-    intptr_t result = 0;
-
-    while (!stream->_terminateStream)
-    {
-        while (!buffer.empty())
-        {       
-            const Packet* readFrom = buffer.readHead();
-            if (!readFrom)
-            {
-                result = 1;
-                break;
-            }
-            std::streamsize sz = 0;
-            uint32_t readFromAmt = 0;
-            while (readFromAmt < readFrom->size)
-            {
-                //  emulating an output of 16 bytes per cycle
-                sz = outfile.sputn((char*)readFrom->data+readFromAmt, 16);
-                if (!sz)
-                    break;
-                usleep(20);
-                readFromAmt += sz;
-            }
-            stream->_outputCount += readFromAmt;
-            if (!sz)
-            {
-                result = 2;
-                break;
-            }
-            buffer.advanceRead();
-            //std::cout << "o" << std::flush;
-
-            pthread_cond_signal(&stream->_writerCond);
-        }
-
-        if (buffer.empty() && !stream->inputActive())
-        {
-            if (!stream->inputActive())
-            {
-                //  buffer is flushed and input is done
-                break;
-            }
-            usleep(20);
-        }
-
-    }
-
-    if (result)
-    {
-        pthread_cond_signal(&stream->_writerCond);
-    }
-    stream->_outputActive = false;
-
-    std::cout << "reader terminated : " << result << std::endl << std::flush;
-
-    return (void* )result;
+    std::cout << "periods : " << stats.periods
+              << ", underruns : " << stats.underruns
+              << ", overruns : " << stats.overruns << std::endl;
+    std::cout << "jitter  : min " << stats.jitterMinNs / 1000
+              << " us, mean " << stats.jitterMeanNs / 1000
+              << " us, max " << stats.jitterMaxNs / 1000 << " us" << std::endl;
+    std::cout << "fill    : min " << stats.fillMin
+              << ", mean " << stats.fillMean
+              << ", max " << stats.fillMax << " of " << capacity << " packets, full for "
+              << stats.fullPeriods << " periods" << std::endl;
 }
 
-
-Streamer::Streamer(std::streambuf& in, std::streambuf& out,
-                   uint32_t bufferCapacity) :
-    _infile(in),
-    _outfile(out),
-    _outputCount(0),
-    _inputActive(true),
-    _outputActive(true),
-    _terminateStream(false),
-    _buffer(64*1024, bufferCapacity),
-    _writerThread(0),
-    _readerThread(0)
+static void printSideStats(const char* name, const PacketBuffer::Stats::Side& side,
+                           const char* waitedOn)
 {
-    //  create our sync objects
-    pthread_mutex_init(&_writerMutex, NULL);
-    pthread_cond_init(&_writerCond, NULL);
-
-    //  spin up our reader and writer threads
-    int res = pthread_create(&_writerThread, NULL, Streamer::writer_thread, this);
-    if (res)
-    {
-        std::cout << "pthread_create(writer) failed: " << res << std::endl;
-        return;
-    }
-
-    res = pthread_create(&_readerThread, NULL, Streamer::reader_thread, this);
-    if (res)
-    {
-        std::cout << "pthread_create(reader) failed: " << res << std::endl;
-        return;
-    }
+    std::cout << name << " : " << side.packets << " packets, " << side.bytes
+              << " bytes, working " << side.workNs / 1000000 << " ms, waited "
+              << side.waitNs / 1000000 << " ms on " << waitedOn << " ring ("
+              << side.waits << " waits)" << std::endl;
 }
 
-Streamer::~Streamer()
+static void printStreamStats(const PacketBuffer::Stats& stats)
 {
-    _terminateStream = true;
-    pthread_join(_writerThread, NULL);
-    pthread_join(_readerThread, NULL);
+    printSideStats("writer", stats.producer, "a full");
+    printSideStats("reader", stats.consumer, "an empty");
+    std::cout << "occupancy :";
+    for (uint32_t bin = 0; bin < PacketBuffer::Stats::kOccupancyBins; ++bin)
+        std::cout << " " << stats.occupancy[bin];
+    std::cout << " (by tenths of capacity)" << std::endl;
 }
 
 
-///////////////////////////////////////////////////////////////////////////////
-
 int main(int argc, const char* argv[])
 {
-    if (argc != 3)
+    RingStorage::Type storageType = RingStorage::kHeap;
+    RingAllocation allocation;
+    WaitStrategy::Policy waitPolicy = WaitStrategy::kBlocking;
+    bool fileIO = false;
+    bool mappedIO = false;
+    bool checksums = false;
+    bool gatherWrites = false;
+    uint32_t pacedBytes = 0;
+    uint64_t pacedPeriodUs = 0;
+    uint32_t stageThreads = 0;
+    bool usage = false;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; ++argi)
     {
-        std::cout << "ringbuffer <in filename> <out filename>" << std::endl;
-        return 1;
+        if (!strcmp(argv[argi], "-m"))
+            storageType = RingStorage::kMirrored;
+        else if (!strcmp(argv[argi], "-H") && argi+1 < argc)
+        {
+            ++argi;
+            if (!strcmp(argv[argi], "thp"))
+                allocation.flags |= RingAllocation::kHugePages;
+            else if (!strcmp(argv[argi], "hugetlb"))
+                allocation.flags |= RingAllocation::kExplicitHugePages;
+            else
+                usage = true;
+        }
+        else if (!strcmp(argv[argi], "-p"))
+            allocation.flags |= RingAllocation::kPrefault;
+        else if (!strcmp(argv[argi], "-a") && argi+1 < argc)
+        {
+            ++argi;
+            if (!strcmp(argv[argi], "line"))
+                allocation.slotAlignment = kCacheLineSize;
+            else if (!strcmp(argv[argi], "page"))
+                allocation.slotAlignment = (uint32_t)RingStorage::pageSize();
+            else
+                usage = true;
+        }
+        else if (!strcmp(argv[argi], "-n") && argi+1 < argc)
+            allocation.numaNode = atoi(argv[++argi]);
+        else if (!strcmp(argv[argi], "-u"))
+            fileIO = true;
+        else if (!strcmp(argv[argi], "-g"))
+            gatherWrites = true;
+        else if (!strcmp(argv[argi], "-M"))
+            mappedIO = true;
+        else if (!strcmp(argv[argi], "-c"))
+            checksums = true;
+        else if (!strcmp(argv[argi], "-r") && argi+1 < argc)
+        {
+            char* period = nullptr;
+            pacedBytes = (uint32_t)strtoul(argv[++argi], &period, 10);
+            if (*period == ',')
+                pacedPeriodUs = strtoull(period + 1, NULL, 10);
+            usage |= !pacedBytes || !pacedPeriodUs;
+        }
+        else if (!strcmp(argv[argi], "-w") && argi+1 < argc)
+            usage |= !WaitStrategy::parsePolicy(argv[++argi], &waitPolicy);
+        else if (!strcmp(argv[argi], "-x") && argi+1 < argc)
+            usage |= !(stageThreads = (uint32_t)strtoul(argv[++argi], NULL, 10));
+        else
+            usage = true;
     }
-    
-    std::filebuf input;
-    if (!input.open(argv[1], std::ios_base::binary | std::ios_base::in))
+    //  gathered writes default to io_uring reads
+    if (gatherWrites && !mappedIO)
+        fileIO = true;
+    //  paced output writes through a streambuf
+    usage |= pacedBytes && (fileIO || mappedIO);
+    //  pipeline buffers aren't checksummed
+    usage |= checksums && stageThreads;
+    //  pipeline stages allocate their own plain rings
+    if (stageThreads && (storageType == RingStorage::kMirrored ||
+                         allocation.flags & (RingAllocation::kHugePages |
+                                             RingAllocation::kExplicitHugePages |
+                                             RingAllocation::kPrefault) ||
+                         allocation.slotAlignment ||
+                         allocation.numaNode >= 0))
     {
-        std::cout << "input file '" << argv[1] << "' failed to open" << std::endl;
-        return 1;
+        std::cout << "-x can't be combined with -m, -H, -p, -a or -n" << std::endl;
+        usage = true;
     }
-
-    std::filebuf output;
-    if (!output.open(argv[2], std::ios_base::binary | std::ios_base::out))
+    if (usage || argc - argi != 2)
     {
-        std::cout << "output file '" << argv[2] << "' failed to open" << std::endl;
+        std::cout << "ringbuffer [-m] [-H thp|hugetlb] [-p] [-a line|page] [-n <node>] [-u] [-M] [-g]" << std::endl;
+        std::cout << "           [-c] [-r <bytes>,<usec>] [-w <policy>] [-x <threads>] <in filename> <out filename>" << std::endl;
+        std::cout << "  -m  use mirrored (double mapped) ring storage" << std::endl;
+        std::cout << "  -H  back the ring with transparent or explicit huge pages" << std::endl;
+        std::cout << "  -p  prefault the ring from the reader thread before streaming" << std::endl;
+        std::cout << "  -a  align each packet to a cache line or page" << std::endl;
+        std::cout << "  -n  place the ring on the given NUMA node" << std::endl;
+        std::cout << "  -u  read and write the files through io_uring" << std::endl;
+        std::cout << "  -M  stream views of the memory mapped input file into a" << std::endl;
+        std::cout << "      memory mapped output file" << std::endl;
+        std::cout << "  -g  write the output with gathered writev calls (with -u or -M)" << std::endl;
+        std::cout << "  -c  checksum (CRC32C) every packet in the ring and verify it" << std::endl;
+        std::cout << "  -r  pace the output at a fixed number of bytes per period, reporting" << std::endl;
+        std::cout << "      underruns, overruns, jitter and buffer fill" << std::endl;
+        std::cout << "  -w  wait policy: spin, yield, block (default), hybrid" << std::endl;
+        std::cout << "  -x  run the stream through a two stage pipeline, with the" << std::endl;
+        std::cout << "      given number of threads per stage (not with -m, -H, -p, -a" << std::endl;
+        std::cout << "      or -n)" << std::endl;
         return 1;
     }
+    const char* inputName = argv[argi];
+    const char* outputName = argv[argi+1];
+
+    std::filebuf inputFile;
+    std::filebuf outputFile;
+    int inputFd = -1;
+    int outputFd = -1;
+    std::unique_ptr<StreamInput> input;
+    std::unique_ptr<StreamOutput> output;
+    PacedOutput* pacedOutput = nullptr;
+    //  the io_uring version uses a deeper ring than the streambuf version,
+    //  to keep several reads and writes in flight.
+    uint32_t capacity = 4;
+
+    if (fileIO || mappedIO)
+    {
+        inputFd = open(inputName, O_RDONLY);
+        if (inputFd < 0)
+        {
+            std::cout << "input file '" << inputName << "' failed to open" << std::endl;
+            return 1;
+        }
+        //  a shared writable mapping needs read access to the file
+        outputFd = open(outputName, (mappedIO ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC,
+                        0644);
+        if (outputFd < 0)
+        {
+            std::cout << "output file '" << outputName << "' failed to open" << std::endl;
+            close(inputFd);
+            return 1;
+        }
+        if (mappedIO)
+        {
+            input.reset(new MappedInput(inputFd));
+        }
+        else
+        {
+            FileInput* fileInput = new FileInput(inputFd, 16);
+            if (fileInput->asynchronous())
+                std::cout << "using io_uring" << std::endl;
+            else
+                std::cout << "io_uring unavailable, using preadv/pwritev" << std::endl;
+            input.reset(fileInput);
+        }
+        if (gatherWrites)
+            output.reset(new GatherOutput(outputFd));
+        else if (mappedIO)
+            output.reset(new MappedOutput(outputFd));
+        else
+            output.reset(new FileOutput(outputFd, 16));
+        capacity = 32;
+    }
+    else
+    {
+        if (!inputFile.open(inputName, std::ios_base::binary | std::ios_base::in))
+        {
+            std::cout << "input file '" << inputName << "' failed to open" << std::endl;
+            return 1;
+        }
+        if (!outputFile.open(outputName, std::ios_base::binary | std::ios_base::out))
+        {
+            std::cout << "output file '" << outputName << "' failed to open" << std::endl;
+            return 1;
+        }
+        input.reset(new StreambufInput(inputFile));
+        if (pacedBytes)
+        {
+            pacedOutput = new PacedOutput(outputFile, pacedBytes, pacedPeriodUs * 1000);
+            output.reset(pacedOutput);
+        }
+        else
+        {
+            output.reset(new StreambufOutput(outputFile));
+        }
+    }
 
-    Streamer stream(input, output, 4);
-
-    uint32_t frame = 0;
-
-    while (stream.active())
+    if (stageThreads)
     {
-        if (!(frame % 60))
+        //  the stages are only as wide as the buffers between them allow.
+        if (capacity <= stageThreads)
+            capacity = stageThreads + 1;
+        XorStage scramble(0x5a);
+        XorStage unscramble(0x5a);
+        Pipeline pipeline(*input, 64*1024, capacity, waitPolicy);
+        pipeline.addStage(scramble, stageThreads, 64*1024, capacity);
+        pipeline.addStage(unscramble, stageThreads, 64*1024, capacity);
+        if (pipeline.start(*output))
+            runStream(pipeline);
+        std::cout << "pipeline result : " << pipeline.result() << std::endl;
+    }
+    else
+    {
+        Streamer stream(*input, *output, 64*1024, capacity, storageType, waitPolicy,
+                        allocation, checksums);
+        runStream(stream);
+        printStreamStats(stream.stats());
+        if (checksums)
         {
-            std::cout << "Output " << stream.outputCount() << " bytes..."
-                      << std::endl << std::flush;
+            std::cout << "checksum errors : " << stream.checksumErrors()
+                      << " (" << crc32cImplementation() << " crc32c)" << std::endl;
         }
-        usleep(16666);          // approximate 60hz (60 fps)
-        ++frame;
     }
-    
+
+    if (pacedOutput)
+        printPacedStats(pacedOutput->stats(), capacity);
+
+    input.reset();
+    output.reset();
+    if (inputFd >= 0)
+        close(inputFd);
+    if (outputFd >= 0)
+        close(outputFd);
     return 0;
-}
\ No newline at end of file
+}
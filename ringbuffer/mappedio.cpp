@@ -0,0 +1,209 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "mappedio.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//  Views the Consumer has released are dropped from the mapping in chunks of
+//  this size, rather than after every release.
+//
+static const size_t kReleaseChunkSize = 4 * 1024 * 1024;
+
+MappedInput::MappedInput(int fd) :
+    _fd(fd),
+    _data(nullptr),
+    _size(0)
+{
+}
+
+MappedInput::~MappedInput()
+{
+    if (_data)
+        munmap(_data, _size);
+}
+
+int MappedInput::produce(PacketBuffer& buffer)
+{
+    struct stat status;
+    if (fstat(_fd, &status) != 0)
+        return errno;
+    if (!status.st_size)
+        return 0;
+
+    void* data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED)
+        return errno;
+    _data = (uint8_t*)data;
+    _size = (size_t)status.st_size;
+    madvise(_data, _size, MADV_SEQUENTIAL);
+
+    const size_t packetSize = buffer.packetDataSize();
+    const uint64_t firstSequence = buffer.writeSequence();
+    size_t offset = 0;
+    size_t releasedOffset = 0;
+
+    //  returns false if the reader closed the buffer on us
+    while (offset < _size && buffer.waitForWrite())
+    {
+        PacketSpan writeTo = buffer.reserveWrite(UINT32_MAX);
+        uint32_t packetCount = 0;
+        while (packetCount < writeTo.count && offset < _size)
+        {
+            Packet& packet = writeTo.packets[packetCount++];
+            packet.data = _data + offset;
+            packet.size = (uint32_t)std::min(packetSize, _size - offset);
+            offset += packet.size;
+        }
+        buffer.commitWrite(packetCount);
+
+        //  every packet but the last is full, so the released views end at
+        //  a multiple of the packet size.
+        size_t consumedOffset = std::min(_size,
+            (size_t)(buffer.readSequence() - firstSequence) * packetSize);
+        size_t releaseOffset = consumedOffset & ~(kReleaseChunkSize - 1);
+        if (releaseOffset > releasedOffset)
+        {
+            madvise(_data + releasedOffset, releaseOffset - releasedOffset,
+                    MADV_DONTNEED);
+            releasedOffset = releaseOffset;
+        }
+    }
+    return 0;
+}
+
+MappedOutput::MappedOutput(int fd, size_t windowSize) :
+    _fd(fd),
+    _windowSize((windowSize + RingStorage::pageSize() - 1) &
+                ~(RingStorage::pageSize() - 1)),
+    _fileSize(0),
+    _window(nullptr),
+    _windowOffset(0),
+    _windowUsed(0)
+{
+}
+
+MappedOutput::~MappedOutput()
+{
+    finish();
+}
+
+//  Extends the file to cover the window, if it doesn't already, then maps it.
+//
+int MappedOutput::mapWindow(size_t offset)
+{
+    if (offset + _windowSize > _fileSize)
+    {
+        if (ftruncate(_fd, (off_t)(offset + _windowSize)) != 0)
+            return errno;
+        _fileSize = offset + _windowSize;
+    }
+    void* window = mmap(NULL, _windowSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        _fd, (off_t)offset);
+    if (window == MAP_FAILED)
+        return errno;
+    _window = (uint8_t*)window;
+    _windowOffset = offset;
+    _windowUsed = 0;
+    return 0;
+}
+
+//  Starts writeback of the window and unmaps it.
+//
+int MappedOutput::unmapWindow()
+{
+    if (!_window)
+        return 0;
+    int result = 0;
+    if (msync(_window, _windowSize, MS_ASYNC) != 0)
+        result = errno;
+    munmap(_window, _windowSize);
+    _window = nullptr;
+    return result;
+}
+
+//  Unmaps the last window and truncates the file to the end of the bytes
+//  written.  Safe to call again.
+//
+int MappedOutput::finish()
+{
+    int result = unmapWindow();
+    size_t writtenSize = _windowOffset + _windowUsed;
+    if (_fileSize != writtenSize)
+    {
+        if (ftruncate(_fd, (off_t)writtenSize) != 0 && !result)
+            result = errno;
+        _fileSize = writtenSize;
+    }
+    return result;
+}
+
+int MappedOutput::consume(PacketBuffer& buffer)
+{
+    int result = mapWindow(0);
+    if (result)
+        return result;
+
+    //  returns false once the buffer is flushed and input is done
+    while (buffer.waitForRead())
+    {
+        ConstPacketSpan readSpan = buffer.peekRead(UINT32_MAX);
+        size_t byteCount = 0;
+        for (uint32_t i = 0; i < readSpan.count; ++i)
+        {
+            const Packet& packet = readSpan.packets[i];
+            uint32_t packetOffset = 0;
+            while (packetOffset < packet.size)
+            {
+                if (_windowUsed == _windowSize)
+                {
+                    size_t nextOffset = _windowOffset + _windowSize;
+                    result = unmapWindow();
+                    if (!result)
+                        result = mapWindow(nextOffset);
+                    if (result)
+                    {
+                        finish();
+                        return result;
+                    }
+                }
+                size_t count = std::min<size_t>(packet.size - packetOffset,
+                                                _windowSize - _windowUsed);
+                memcpy(_window + _windowUsed, packet.data + packetOffset, count);
+                _windowUsed += count;
+                packetOffset += (uint32_t)count;
+            }
+            byteCount += packet.size;
+        }
+        buffer.releaseRead(readSpan.count);
+        addOutputCount(byteCount);
+    }
+    return finish();
+}
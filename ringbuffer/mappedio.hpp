@@ -0,0 +1,102 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_MappedIO_hpp
+#define CK_Sample_MappedIO_hpp
+
+#include "streamer.hpp"
+
+//  Streams a file without copying it - the input is mapped into memory and
+//  each packet committed to the buffer is a view of the mapping rather than a
+//  copy in the packet's own slot.
+//
+//  The mapping is advised for sequential access, so the kernel reads ahead
+//  of the Consumer, and the views the Consumer has released are dropped from
+//  the process as the stream moves on.  Views stay valid until the input is
+//  destroyed, so the input must outlive the stream.  The file must be a
+//  regular file.
+//
+class MappedInput : public StreamInput
+{
+public:
+    MappedInput(int fd);
+    ~MappedInput();
+
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    int produce(PacketBuffer& buffer) override;
+
+private:
+    int _fd;
+    uint8_t* _data;
+    size_t _size;
+};
+
+//  Writes packets into a mapping of the output file, which grows a window at
+//  a time.
+//
+//  The file is extended (ftruncate) by a window before the window is mapped,
+//  and is only ever grown while streaming - when the stream ends (or the
+//  output is destroyed) it's truncated once to the bytes actually written.
+//  The file must be a regular file opened for reading and writing.
+//
+//  Each filled window is flushed with msync(MS_ASYNC) as it's unmapped.
+//  That's the intended cadence: it starts writeback a window at a time
+//  without waiting on it, so the Consumer never stalls on the disk.  Nothing
+//  is made durable - callers that need that should fsync the file after the
+//  stream ends.
+//
+//  Packets are copied once, from the packet straight into the page cache -
+//  paired with a MappedInput that's a single copy from file to file.
+//
+class MappedOutput : public StreamOutput
+{
+public:
+    //  windowSize is rounded up to a multiple of the page size.
+    MappedOutput(int fd, size_t windowSize=16*1024*1024);
+    ~MappedOutput();
+
+    MappedOutput(const MappedOutput&) = delete;
+    MappedOutput& operator=(const MappedOutput&) = delete;
+
+    int consume(PacketBuffer& buffer) override;
+
+private:
+    int mapWindow(size_t offset);
+    int unmapWindow();
+    int finish();
+
+    int _fd;
+    const size_t _windowSize;
+    //  the file's length, including the unwritten end of the last window
+    size_t _fileSize;
+    uint8_t* _window;
+    //  the file offset of the window, and bytes written to it.
+    size_t _windowOffset;
+    size_t _windowUsed;
+};
+
+
+#endif
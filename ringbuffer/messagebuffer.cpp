@@ -0,0 +1,122 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "messagebuffer.hpp"
+
+//  Positions are free running byte counters - the offset into the ring is
+//  the position masked by the capacity, and (write - read) is the number of
+//  bytes in use even after the counters wrap.
+//
+MessageBuffer::MessageBuffer(uint32_t byteCapacity) :
+    _capacity(roundUpToPowerOf2(byteCapacity < 64 ? 64 : byteCapacity)),
+    _mask(_capacity - 1),
+    _byteBuffer(_capacity / sizeof(uint64_t)),
+    _writePosition(0),
+    _readPositionCache(0),
+    _reservePosition(0),
+    _readPosition(0),
+    _writePositionCache(0)
+{
+}
+
+const uint8_t* MessageBuffer::readHead(uint32_t* size)
+{
+    uint32_t readPosition = _readPosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (readPosition == _writePositionCache)
+        {
+            _writePositionCache = _writePosition.load(std::memory_order_acquire);
+            if (readPosition == _writePositionCache)
+                return nullptr;
+        }
+        const RecordHeader* header = headerAt(readPosition);
+        if (!(header->flags & kRecordFlag_Padding))
+        {
+            *size = header->size;
+            return reinterpret_cast<const uint8_t*>(header + 1);
+        }
+        //  skip past padding at the end of the ring, releasing it to the
+        //  Producer right away.
+        readPosition += header->size;
+        _readPosition.store(readPosition, std::memory_order_release);
+    }
+}
+
+bool MessageBuffer::advanceRead()
+{
+    uint32_t size;
+    if (!readHead(&size))
+        return false;
+    uint32_t readPosition = _readPosition.load(std::memory_order_relaxed);
+    _readPosition.store(readPosition + recordLength(size),
+                        std::memory_order_release);
+    return true;
+}
+
+uint8_t* MessageBuffer::reserveWrite(uint32_t size)
+{
+    if (size > maxMessageSize())
+        return nullptr;
+
+    uint32_t writePosition = _writePosition.load(std::memory_order_relaxed);
+    uint32_t length = recordLength(size);
+    uint32_t offset = writePosition & _mask;
+    uint32_t padding = offset + length > _capacity ? _capacity - offset : 0;
+
+    uint32_t available = _capacity - (writePosition - _readPositionCache);
+    if (available < padding + length)
+    {
+        _readPositionCache = _readPosition.load(std::memory_order_acquire);
+        available = _capacity - (writePosition - _readPositionCache);
+    }
+    if (padding)
+    {
+        //  publish the padding record on its own, so that the Consumer can
+        //  release the end of the ring even if the record itself must wait
+        //  for more space at the start of the ring.
+        if (available < padding)
+            return nullptr;
+        RecordHeader* header = headerAt(writePosition);
+        header->size = padding;
+        header->flags = kRecordFlag_Padding;
+        writePosition += padding;
+        available -= padding;
+        _writePosition.store(writePosition, std::memory_order_release);
+    }
+    if (available < length)
+        return nullptr;
+
+    _reservePosition = writePosition;
+    return reinterpret_cast<uint8_t*>(headerAt(writePosition) + 1);
+}
+
+void MessageBuffer::commitWrite(uint32_t size)
+{
+    RecordHeader* header = headerAt(_reservePosition);
+    header->size = size;
+    header->flags = 0;
+    _writePosition.store(_reservePosition + recordLength(size),
+                         std::memory_order_release);
+}
@@ -0,0 +1,125 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_MessageBuffer_hpp
+#define CK_Sample_MessageBuffer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//  A single Producer, single Consumer ring of variable length messages.
+//
+//  Where the PacketBuffer divides its memory into fixed size packets, the
+//  MessageBuffer packs length-prefixed records into a byte ring so that small
+//  messages only use the memory they need.  Every record is contiguous in
+//  memory - if a record won't fit between the write position and the end of
+//  the ring, the Producer fills that gap with a padding record (skipped by the
+//  Consumer) and writes the record at the start of the ring.  Memory is
+//  returned to the Producer as each record is consumed.
+//
+//  Records and their payloads are aligned to 8 bytes.  Synchronization
+//  follows the PacketBuffer: acquire/release byte positions on separate cache
+//  lines, each side caching the other's position.
+//
+class MessageBuffer
+{
+public:
+    //  The capacity is rounded up to a power of two.
+    MessageBuffer(uint32_t byteCapacity);
+
+    //  The largest message that can be written to the buffer.
+    uint32_t maxMessageSize() const;
+
+    bool empty() const;
+
+    //  Consumer methods
+    //  Returns the payload of the record at the read head, or nullptr if
+    //  the buffer is empty.  The payload's size is returned in size.
+    const uint8_t* readHead(uint32_t* size);
+    //  Releases the record returned by readHead.
+    bool advanceRead();
+
+    //  Producer methods
+    //  Returns a contiguous region of at least size bytes for a new record,
+    //  or nullptr if there isn't enough free space (or size exceeds
+    //  maxMessageSize.)
+    uint8_t* reserveWrite(uint32_t size);
+    //  Publishes the reserved record, with a payload of size bytes (which may
+    //  be less than the size reserved.)
+    void commitWrite(uint32_t size);
+
+private:
+    struct RecordHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+    };
+    enum
+    {
+        kRecordFlag_Padding = 0x0001
+    };
+
+    RecordHeader* headerAt(uint32_t position);
+    uint32_t recordLength(uint32_t payloadSize) const;
+
+    const uint32_t _capacity;
+    const uint32_t _mask;
+    std::vector<uint64_t> _byteBuffer;
+
+    //  Producer owned - _writePosition is shared with the Consumer.
+    alignas(kCacheLineSize) std::atomic<uint32_t> _writePosition;
+    uint32_t _readPositionCache;
+    uint32_t _reservePosition;
+    //  Consumer owned - _readPosition is shared with the Producer.
+    alignas(kCacheLineSize) std::atomic<uint32_t> _readPosition;
+    uint32_t _writePositionCache;
+};
+
+inline uint32_t MessageBuffer::maxMessageSize() const
+{
+    return _capacity - sizeof(RecordHeader);
+}
+
+inline bool MessageBuffer::empty() const
+{
+    return _readPosition.load(std::memory_order_relaxed) ==
+           _writePosition.load(std::memory_order_acquire);
+}
+
+inline uint32_t MessageBuffer::recordLength(uint32_t payloadSize) const
+{
+    return (sizeof(RecordHeader) + payloadSize + 7) & ~7;
+}
+
+inline auto MessageBuffer::headerAt(uint32_t position) -> RecordHeader*
+{
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(_byteBuffer.data());
+    return reinterpret_cast<RecordHeader*>(bytes + (position & _mask));
+}
+
+
+#endif
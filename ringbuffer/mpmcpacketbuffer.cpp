@@ -0,0 +1,139 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "mpmcpacketbuffer.hpp"
+
+#include <cstdlib>
+#include <new>
+
+MPMCPacketBuffer::MPMCPacketBuffer(uint32_t packetDataSize,
+                                   uint32_t packetCapacity) :
+    _packetDataSize(packetDataSize),
+    _packetCapacity(packetCapacity),
+    _byteBuffer((size_t)packetDataSize*packetCapacity, RingStorage::kHeap),
+    _slots(nullptr),
+    _writeSequence(0),
+    _readSequence(0)
+{
+    //  std::vector won't align the slots to a cache line before C++17.
+    void* slots = nullptr;
+    if (posix_memalign(&slots, kCacheLineSize, sizeof(Slot) * _packetCapacity))
+        abort();
+    _slots = reinterpret_cast<Slot*>(slots);
+
+    uint8_t* packetData = _byteBuffer.data();
+    for (uint32_t i = 0; i < _packetCapacity; ++i)
+    {
+        Slot* slot = new(&_slots[i]) Slot;
+        slot->sequence.store(i, std::memory_order_relaxed);
+        slot->packet.data = packetData;
+        slot->packet.size = 0;
+        slot->packet.checksum = 0;
+        packetData += packetDataSize;
+    }
+}
+
+MPMCPacketBuffer::~MPMCPacketBuffer()
+{
+    for (uint32_t i = 0; i < _packetCapacity; ++i)
+    {
+        _slots[i].~Slot();
+    }
+    free(_slots);
+}
+
+bool MPMCPacketBuffer::claimRead(PacketTicket* ticket)
+{
+    uint64_t readSequence = _readSequence.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot& slot = slotAt(readSequence);
+        uint64_t slotSequence = slot.sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(slotSequence - (readSequence + 1));
+        if (diff == 0)
+        {
+            //  the slot is written - try to claim it.  on failure another
+            //  Consumer got there first, and readSequence is reloaded.
+            if (_readSequence.compare_exchange_weak(readSequence, readSequence + 1,
+                                                    std::memory_order_relaxed))
+            {
+                ticket->packet = &slot.packet;
+                ticket->sequence = readSequence;
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            //  the slot hasn't been written yet
+            return false;
+        }
+        else
+        {
+            readSequence = _readSequence.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void MPMCPacketBuffer::releaseRead(const PacketTicket& ticket)
+{
+    slotAt(ticket.sequence).sequence.store(ticket.sequence + _packetCapacity,
+                                           std::memory_order_release);
+}
+
+bool MPMCPacketBuffer::claimWrite(PacketTicket* ticket)
+{
+    uint64_t writeSequence = _writeSequence.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot& slot = slotAt(writeSequence);
+        uint64_t slotSequence = slot.sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(slotSequence - writeSequence);
+        if (diff == 0)
+        {
+            if (_writeSequence.compare_exchange_weak(writeSequence, writeSequence + 1,
+                                                     std::memory_order_relaxed))
+            {
+                slot.packet.size = _packetDataSize;
+                ticket->packet = &slot.packet;
+                ticket->sequence = writeSequence;
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            //  the slot from the previous lap hasn't been released yet
+            return false;
+        }
+        else
+        {
+            writeSequence = _writeSequence.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void MPMCPacketBuffer::commitWrite(const PacketTicket& ticket)
+{
+    slotAt(ticket.sequence).sequence.store(ticket.sequence + 1,
+                                           std::memory_order_release);
+}
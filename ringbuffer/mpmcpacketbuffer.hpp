@@ -0,0 +1,108 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_MPMCPacketBuffer_hpp
+#define CK_Sample_MPMCPacketBuffer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+//  A packet claimed from an MPMCPacketBuffer.  The sequence identifies the
+//  claim when the packet is committed or released.
+struct PacketTicket
+{
+    Packet* packet;
+    uint64_t sequence;
+};
+
+//  A bounded ring buffer for any number of Producers and Consumers, using the
+//  same packet layout as the PacketBuffer.
+//
+//  Each packet slot carries a sequence number that tells a claimant whether
+//  the slot is ready for it:
+//      sequence == n               - free, and may be claimed by the n'th write
+//      sequence == n + 1           - written, and may be claimed by the n'th read
+//      sequence == n + capacity    - released, and free for the next lap
+//
+//  Producers (and Consumers) only contend on a single compare-and-swap of the
+//  write (or read) sequence to claim a slot.  Filling or draining the slot
+//  happens outside of that, so many threads can work on different slots at
+//  once.  A claimed slot must be committed (or released) for the slots behind
+//  it to become visible to the other side.  Each slot sits on its own cache
+//  line, so threads working on neighbouring slots don't contend.
+//
+class MPMCPacketBuffer
+{
+public:
+    MPMCPacketBuffer(uint32_t packetDataSize, uint32_t packetCapacity);
+    ~MPMCPacketBuffer();
+
+    MPMCPacketBuffer(const MPMCPacketBuffer&) = delete;
+    MPMCPacketBuffer& operator=(const MPMCPacketBuffer&) = delete;
+
+    uint32_t packetDataSize() const { return _packetDataSize; }
+    uint32_t capacity() const { return _packetCapacity; }
+
+    //  Consumer methods
+    //  Claims the oldest written packet.  Returns false if the buffer is
+    //  empty.
+    bool claimRead(PacketTicket* ticket);
+    //  Returns a packet claimed by claimRead to the Producers.
+    void releaseRead(const PacketTicket& ticket);
+
+    //  Producer methods
+    //  Claims the next free packet, sized to the packet data size.  Returns
+    //  false if the buffer is full.
+    bool claimWrite(PacketTicket* ticket);
+    //  Publishes a packet claimed by claimWrite to the Consumers.
+    void commitWrite(const PacketTicket& ticket);
+
+private:
+    struct Slot
+    {
+        alignas(kCacheLineSize) std::atomic<uint64_t> sequence;
+        Packet packet;
+    };
+
+    Slot& slotAt(uint64_t sequence);
+
+    const uint32_t _packetDataSize;
+    const uint32_t _packetCapacity;
+    RingStorage _byteBuffer;
+    //  one per packet, cache line aligned.
+    Slot* _slots;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> _writeSequence;
+    alignas(kCacheLineSize) std::atomic<uint64_t> _readSequence;
+};
+
+inline auto MPMCPacketBuffer::slotAt(uint64_t sequence) -> Slot&
+{
+    return _slots[sequence % _packetCapacity];
+}
+
+
+#endif
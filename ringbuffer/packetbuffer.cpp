@@ -23,51 +23,326 @@
  */
 
 #include "packetbuffer.hpp"
+#include "crc32c.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 
+static uint64_t statsClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//  Counters have a single writer, so they're bumped without a locked
+//  read-modify-write.
+//
+static void addTo(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
 PacketBuffer::PacketBuffer(uint32_t packetDataSize,
-                           uint32_t packetCapacity) :
+                           uint32_t packetCapacity,
+                           RingStorage::Type storageType,
+                           WaitStrategy::Policy waitPolicy,
+                           const RingAllocation& allocation) :
     _packetDataSize(packetDataSize),
-    _byteBuffer(packetDataSize*packetCapacity),
-    _packets(packetCapacity),
-    _readIndex(0),
-    _writeIndex(0)
+    _packetStride(allocation.slotAlignment ?
+        (packetDataSize + allocation.slotAlignment - 1) & ~(allocation.slotAlignment - 1) :
+        packetDataSize),
+    _packetCapacity(packetCapacity),
+    _byteBuffer((size_t)_packetStride*packetCapacity, storageType, allocation),
+    _packets(mirrored() ? packetCapacity*2 : packetCapacity),
+    _checksums(false),
+    _stats(false),
+    _index(packetCapacity),
+    _verifiedSequence(0),
+    _checksumErrors(0),
+    _readWait(waitPolicy),
+    _writeWait(waitPolicy),
+    _closed(false)
 {
     uint8_t* packetData = _byteBuffer.data();
     for(auto& packet : _packets)
     {
         packet.data = packetData;
         packet.size = 0;
-        packetData += packetDataSize;
+        packet.checksum = 0;
+        packetData += _packetStride;
+    }
+    SideCounters* sides[] = { &_producerStats, &_consumerStats };
+    for (SideCounters* side : sides)
+    {
+        side->packets = 0;
+        side->bytes = 0;
+        side->waits = 0;
+        side->waitNs = 0;
+        side->firstNs = 0;
+        side->latestNs = 0;
+        for (auto& bin : side->occupancy)
+            bin = 0;
+    }
+}
+
+void* PacketBuffer::operator new(size_t size) noexcept
+{
+    void* p = nullptr;
+    if (posix_memalign(&p, kCacheLineSize, size))
+        return nullptr;
+    return p;
+}
+
+void PacketBuffer::operator delete(void* p)
+{
+    free(p);
+}
+
+void PacketBuffer::close()
+{
+    _closed.store(true, std::memory_order_release);
+    _readWait.notify();
+    _writeWait.notify();
+}
+
+bool PacketBuffer::waitForRead()
+{
+    if (_stats && empty() && !closed())
+    {
+        uint64_t startNs = statsClock();
+        _readWait.wait([this]() -> bool { return !empty() || closed(); });
+        recordWait(_consumerStats, startNs);
+    }
+    else
+    {
+        _readWait.wait([this]() -> bool { return !empty() || closed(); });
+    }
+    return !empty();
+}
+
+bool PacketBuffer::waitForWrite()
+{
+    if (_stats && full() && !closed())
+    {
+        uint64_t startNs = statsClock();
+        _writeWait.wait([this]() -> bool { return !full() || closed(); });
+        recordWait(_producerStats, startNs);
     }
+    else
+    {
+        _writeWait.wait([this]() -> bool { return !full() || closed(); });
+    }
+    return !closed();
 }
 
 const Packet* PacketBuffer::readHead()
 {
-    if (empty())
+    if (!_index.readable(1))
         return nullptr;
-    return &_packets[_readIndex];
+    const Packet* packet = &_packets[_index.readIndex()];
+    if (_checksums)
+        verifyPackets(packet, _index.readSequence(), 1);
+    return packet;
 }
 
 bool PacketBuffer::advanceRead()
 {
-    if (_readIndex == _writeIndex)
+    if (!_index.readable(1))
         return false;
-    _readIndex = (_readIndex + 1) % _packets.size();
+    if (_stats)
+        recordTransfer(_consumerStats, _index.readIndex(), 1);
+    _index.releaseRead(1);
+    _writeWait.notify();
     return true;
 }
 
+ConstPacketSpan PacketBuffer::peekRead(uint32_t maxCount, uint32_t skipCount)
+{
+    ConstPacketSpan span = { nullptr, 0, 0 };
+    uint32_t available = _index.readable(skipCount + maxCount);
+    if (available <= skipCount)
+        return span;
+    available -= skipCount;
+    uint32_t readIndex = skipIndex(_index.readIndex(), skipCount);
+    span.sequence = _index.readSequence() + skipCount;
+    span.count = std::min(std::min(available, maxCount), contiguousCount(readIndex));
+    if (span.count)
+    {
+        span.packets = &_packets[readIndex];
+        //  the Producer may have written wrapped packets through either the
+        //  mirrored or the original descriptor - commitWrite leaves them in
+        //  the originals, so refresh the mirrors we're handing out.
+        for (uint32_t i = capacity(); i < readIndex + span.count; ++i)
+            _packets[i] = _packets[i - capacity()];
+        if (_checksums)
+            verifyPackets(span.packets, span.sequence, span.count);
+    }
+    return span;
+}
+
+void PacketBuffer::releaseRead(uint32_t count)
+{
+    if (_stats)
+        recordTransfer(_consumerStats, _index.readIndex(), count);
+    _index.releaseRead(count);
+    _writeWait.notify();
+}
+
 Packet* PacketBuffer::writeHead()
 {
-    _packets[_writeIndex].size = _packetDataSize;
-    return &_packets[_writeIndex];
+    //  every slot is usable, so the slot at the write index may still hold
+    //  a packet the Consumer hasn't read.
+    if (!_index.writable(1))
+        return nullptr;
+    uint32_t writeIndex = _index.writeIndex();
+    Packet& packet = _packets[writeIndex];
+    packet.data = packetData(writeIndex);
+    packet.size = _packetDataSize;
+    return &packet;
 }
 
 bool PacketBuffer::advanceWrite()
 {
-    if (nextWriteIndex() == _readIndex)
+    if (!_index.writable(1))
         return false;
-    _writeIndex = nextWriteIndex();
+    uint32_t writeIndex = _index.writeIndex();
+    if (_checksums)
+        sealPackets(writeIndex, 1);
+    _index.commitWrite(1);
+    if (_stats)
+        recordTransfer(_producerStats, writeIndex, 1);
+    _readWait.notify();
     return true;
 }
+
+PacketSpan PacketBuffer::reserveWrite(uint32_t maxCount, uint32_t skipCount)
+{
+    PacketSpan span = { nullptr, 0, 0 };
+    uint32_t available = _index.writable(skipCount + maxCount);
+    if (available <= skipCount)
+        return span;
+    available -= skipCount;
+    uint32_t writeIndex = skipIndex(_index.writeIndex(), skipCount);
+    span.sequence = _index.writeSequence() + skipCount;
+    span.count = std::min(std::min(available, maxCount), contiguousCount(writeIndex));
+    if (span.count)
+    {
+        span.packets = &_packets[writeIndex];
+        for (uint32_t i = 0; i < span.count; ++i)
+        {
+            span.packets[i].data = packetData(writeIndex + i);
+            span.packets[i].size = _packetDataSize;
+        }
+    }
+    return span;
+}
+
+void PacketBuffer::commitWrite(uint32_t count)
+{
+    uint32_t writeIndex = _index.writeIndex();
+    if (_checksums)
+        sealPackets(writeIndex, count);
+    //  packets reserved separately (using skipCount) may run past the end of
+    //  the array - only mirrored descriptors need copying back down.
+    if (mirrored())
+    {
+        for (uint32_t i = capacity(); i < writeIndex + count; ++i)
+            _packets[i - capacity()] = _packets[i];
+    }
+    _index.commitWrite(count);
+    if (_stats)
+        recordTransfer(_producerStats, writeIndex, count);
+    _readWait.notify();
+}
+
+void PacketBuffer::sealPackets(uint32_t index, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Packet& packet = _packets[skipIndex(index, i)];
+        packet.checksum = crc32c(0, packet.data, packet.size);
+    }
+}
+
+//  Packets are verified once, the first time they're returned - peeking at
+//  the same packets again doesn't recount their errors.
+//
+void PacketBuffer::verifyPackets(const Packet* packets, uint64_t sequence,
+                                 uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (sequence + i < _verifiedSequence)
+            continue;
+        const Packet& packet = packets[i];
+        if (crc32c(0, packet.data, packet.size) != packet.checksum)
+            ++_checksumErrors;
+    }
+    _verifiedSequence = std::max(_verifiedSequence, sequence + count);
+}
+
+auto PacketBuffer::stats() const -> Stats
+{
+    Stats stats;
+    readSide(_producerStats, stats.producer);
+    readSide(_consumerStats, stats.consumer);
+    for (uint32_t bin = 0; bin < Stats::kOccupancyBins; ++bin)
+    {
+        stats.occupancy[bin] =
+            _producerStats.occupancy[bin].load(std::memory_order_relaxed) +
+            _consumerStats.occupancy[bin].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void PacketBuffer::readSide(const SideCounters& side, Stats::Side& stats)
+{
+    stats.packets = side.packets.load(std::memory_order_relaxed);
+    stats.bytes = side.bytes.load(std::memory_order_relaxed);
+    stats.waits = side.waits.load(std::memory_order_relaxed);
+    stats.waitNs = side.waitNs.load(std::memory_order_relaxed);
+    uint64_t firstNs = side.firstNs.load(std::memory_order_relaxed);
+    uint64_t latestNs = side.latestNs.load(std::memory_order_relaxed);
+    uint64_t activeNs = firstNs && latestNs > firstNs ? latestNs - firstNs : 0;
+    stats.workNs = activeNs > stats.waitNs ? activeNs - stats.waitNs : 0;
+}
+
+void PacketBuffer::recordWait(SideCounters& side, uint64_t startNs)
+{
+    uint64_t nowNs = statsClock();
+    if (!side.firstNs.load(std::memory_order_relaxed))
+        side.firstNs.store(startNs, std::memory_order_relaxed);
+    side.latestNs.store(nowNs, std::memory_order_relaxed);
+    addTo(side.waits, 1);
+    addTo(side.waitNs, nowNs - startNs);
+}
+
+//  Called after a commit (or before a release), once the descriptors at the
+//  original indices hold the packets' final sizes.
+//
+void PacketBuffer::recordTransfer(SideCounters& side, uint32_t index, uint32_t count)
+{
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t packetIndex = index + i;
+        if (packetIndex >= _packetCapacity)
+            packetIndex -= _packetCapacity;
+        bytes += _packets[packetIndex].size;
+    }
+    addTo(side.packets, count);
+    addTo(side.bytes, bytes);
+
+    uint64_t occupancy = _index.writeSequence() - _index.readSequence();
+    uint64_t bin = occupancy * Stats::kOccupancyBins / _packetCapacity;
+    if (bin >= Stats::kOccupancyBins)
+        bin = Stats::kOccupancyBins - 1;
+    addTo(side.occupancy[bin], 1);
+
+    uint64_t nowNs = statsClock();
+    if (!side.firstNs.load(std::memory_order_relaxed))
+        side.firstNs.store(nowNs, std::memory_order_relaxed);
+    side.latestNs.store(nowNs, std::memory_order_relaxed);
+}
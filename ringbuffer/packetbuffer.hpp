@@ -25,6 +25,12 @@
 #ifndef CK_Sample_PacketBuffer_hpp
 #define CK_Sample_PacketBuffer_hpp
 
+#include "ringindex.hpp"
+#include "ringstorage.hpp"
+#include "waitstrategy.hpp"
+
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -32,6 +38,29 @@ struct Packet
 {
     uint8_t* data;
     uint32_t size;
+    //  The CRC32C of the packet's data, for buffers that checksum packets.
+    uint32_t checksum;
+};
+
+//  A run of packets that are contiguous in the buffer's packet array.  Unless
+//  the buffer pads its packets (see PacketBuffer::packetStride), the
+//  packets' data is also contiguous in memory, so a span of full packets may
+//  be treated as a single block of count * packet data size bytes.
+//
+//  A PacketBuffer also returns the sequence number of the span's first
+//  packet (see PacketBuffer::readSequence.)
+struct PacketSpan
+{
+    Packet* packets;
+    uint32_t count;
+    uint64_t sequence;
+};
+
+struct ConstPacketSpan
+{
+    const Packet* packets;
+    uint32_t count;
+    uint64_t sequence;
 };
 
 //  The Ring Buffer is best accessed by at least two threads.  The typical ring
@@ -42,37 +71,238 @@ struct Packet
 //  into the tail packet of the buffer, while a Consumer pulls packets from the
 //  head of the buffer.
 //
+//  The buffer is lock-free for a single Producer and a single Consumer,
+//  synchronized through a RingIndex.  Every packet written is numbered by a
+//  64-bit sequence, so all packetCapacity packets are usable, and a power of
+//  two capacity maps sequences to packets with a mask instead of a division.
+//
+//  Packets may be written and read one at a time (writeHead/advanceWrite,
+//  readHead/advanceRead) or in batches (reserveWrite/commitWrite,
+//  peekRead/releaseRead), where a batch publishes its index update once for
+//  all of its packets.
+//
+//  A Producer or Consumer that must wait on the other side can use
+//  waitForWrite/waitForRead, which wait according to the buffer's
+//  WaitStrategy policy.  Either side may close() the buffer to release the
+//  other from its wait (for example at the end of a stream.)
+//
+//  With RingStorage::kMirrored storage, the packet array is mirrored along
+//  with the packet data, so spans no longer stop at the end of the array -
+//  any span up to the buffer's capacity is contiguous.  This requires
+//  packetDataSize * packetCapacity to be a multiple of the page size.
+//
+//  A Producer may point a reserved packet's data at memory of its own (a view
+//  of a file mapping, for instance) instead of filling the packet's slot, so
+//  long as that memory outlives the packet's release by the Consumer.  Every
+//  reserved packet starts out pointing at its own slot.
+//
+//  With checksums enabled, each packet is checksummed (CRC32C) as it's
+//  committed, while its data is still hot in the Producer's cache, and
+//  verified the first time the Consumer reads it.
+//
+//  The RingAllocation selects huge pages, NUMA placement and prefaulting for
+//  the packet memory.  Its slotAlignment pads every packet's data out to a
+//  multiple of the alignment (packetStride.)
+//
+//  With stats enabled, each side counts the packets and bytes it moves and
+//  the time it spends blocked in waitForWrite/waitForRead, and samples the
+//  buffer's occupancy on every commit and release.  A side that waits often
+//  is outpaced by the other - a Consumer waiting on an empty buffer means the
+//  Producer (or its I/O) is the bottleneck.
 //
 class PacketBuffer
 {
 public:
-    PacketBuffer(uint32_t packetDataSize, uint32_t packetCapacity);
+    //  A snapshot of the buffer's stats.
+    struct Stats
+    {
+        struct Side
+        {
+            uint64_t packets;
+            uint64_t bytes;
+            //  The waits that found the buffer full (Producer) or empty
+            //  (Consumer), and the time spent in them.
+            uint64_t waits;
+            uint64_t waitNs;
+            //  The time between the side's first and latest operations, less
+            //  the time spent waiting.
+            uint64_t workNs;
+        };
+        Side producer;
+        Side consumer;
+
+        //  Occupancy samples binned by tenths of the capacity - the last bin
+        //  also counts samples taken with the buffer full.
+        static const uint32_t kOccupancyBins = 10;
+        uint64_t occupancy[kOccupancyBins];
+    };
 
+    PacketBuffer(uint32_t packetDataSize, uint32_t packetCapacity,
+                 RingStorage::Type storageType=RingStorage::kHeap,
+                 WaitStrategy::Policy waitPolicy=WaitStrategy::kSpinYield,
+                 const RingAllocation& allocation=RingAllocation());
+
+    //  Keeps heap allocated buffers cache line aligned (before C++17, plain
+    //  operator new only aligns to alignof(max_align_t).)
+    static void* operator new(size_t size) noexcept;
+    static void operator delete(void* p);
+
+    uint32_t packetDataSize() const { return _packetDataSize; }
+    //  The distance between consecutive packets' data.
+    uint32_t packetStride() const { return _packetStride; }
+    uint32_t capacity() const { return _packetCapacity; }
+    //  True if spans may wrap past the end of the packet array.
+    bool mirrored() const { return _byteBuffer.type() == RingStorage::kMirrored; }
+    //  The memory holding the packets' data, for registering with I/O
+    //  interfaces.
+    RingStorage& storage() { return _byteBuffer; }
+
+    //  Safe to call from either thread, though the result is only stable
+    //  when called by the Consumer.
     bool empty() const;
+
+    //  The sequence numbers of the next packet to be read and written,
+    //  counting every packet since the buffer was created.  The Consumer's
+    //  lag is writeSequence() - readSequence().
+    uint64_t readSequence() const { return _index.readSequence(); }
+    uint64_t writeSequence() const { return _index.writeSequence(); }
+
+    //  Enables packet checksums.  Call before either side starts.
+    void enableChecksums() { _checksums = true; }
+    bool checksums() const { return _checksums; }
+    //  The packets that failed verification so far - only stable when called
+    //  by the Consumer.
+    uint64_t checksumErrors() const { return _checksumErrors; }
+
+    //  Enables stats.  Call before either side starts.
+    void enableStats() { _stats = true; }
+    bool statsEnabled() const { return _stats; }
+    //  Safe to call from any thread while the buffer is in use.
+    Stats stats() const;
+
+    //  Closes the buffer, releasing any waiting Producer or Consumer.
+    //  Packets already written may still be read.
+    void close();
+    bool closed() const;
     
+    //  Consumer methods
+    //  Waits until a packet is readable.  Returns false if the buffer was
+    //  closed and has no packets left to read.
+    bool waitForRead();
     const Packet* readHead();
     bool advanceRead();
+    //  Returns up to maxCount readable packets starting skipCount packets
+    //  past the read head.  Unless the buffer is mirrored, the span stops at
+    //  the end of the packet array, so a second call (skipping the packets
+    //  returned by the first) may return the remaining packets at the start
+    //  of the array.
+    ConstPacketSpan peekRead(uint32_t maxCount, uint32_t skipCount=0);
+    //  Releases count packets (at most the count returned by peekRead) back
+    //  to the Producer.
+    void releaseRead(uint32_t count);
+
+    //  Producer methods
+    //  Waits until a packet is writable.  Returns false if the buffer was
+    //  closed.
+    bool waitForWrite();
+    //  Returns the packet at the write head, or nullptr if the buffer is
+    //  full.
     Packet* writeHead();
     bool advanceWrite();
+    //  Returns up to maxCount writable packets starting skipCount packets
+    //  past the write head, each sized to the buffer's packet data size.  As
+    //  with peekRead, the span stops at the end of the packet array unless
+    //  the buffer is mirrored.
+    PacketSpan reserveWrite(uint32_t maxCount, uint32_t skipCount=0);
+    //  Publishes count packets (at most the count returned by reserveWrite)
+    //  to the Consumer.
+    void commitWrite(uint32_t count);
 
 private:
-    uint32_t nextWriteIndex() const;
+    //  Written by one side only, but read by stats() from any thread.
+    struct SideCounters
+    {
+        std::atomic<uint64_t> packets;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> waits;
+        std::atomic<uint64_t> waitNs;
+        std::atomic<uint64_t> firstNs;
+        std::atomic<uint64_t> latestNs;
+        std::atomic<uint64_t> occupancy[Stats::kOccupancyBins];
+    };
+
+    uint8_t* packetData(uint32_t index);
+    void recordWait(SideCounters& side, uint64_t startNs);
+    void recordTransfer(SideCounters& side, uint32_t index, uint32_t count);
+    static void readSide(const SideCounters& side, Stats::Side& stats);
+    void sealPackets(uint32_t index, uint32_t count);
+    void verifyPackets(const Packet* packets, uint64_t sequence, uint32_t count);
+    uint32_t contiguousCount(uint32_t index) const;
+    uint32_t skipIndex(uint32_t index, uint32_t skipCount) const;
+    bool full() const;
 
     const uint32_t _packetDataSize;
-    std::vector<uint8_t> _byteBuffer;
+    const uint32_t _packetStride;
+    const uint32_t _packetCapacity;
+    RingStorage _byteBuffer;
+    //  When mirrored, holds twice the capacity, where packet[capacity + i]
+    //  aliases packet[i].
     std::vector<Packet> _packets;
-    volatile uint32_t _readIndex;
-    volatile uint32_t _writeIndex;
+
+    bool _checksums;
+    bool _stats;
+
+    RingIndex _index;
+
+    //  Consumer owned - packets before _verifiedSequence have been verified.
+    alignas(kCacheLineSize) uint64_t _verifiedSequence;
+    uint64_t _checksumErrors;
+
+    alignas(kCacheLineSize) SideCounters _producerStats;
+    alignas(kCacheLineSize) SideCounters _consumerStats;
+
+    //  Waited on by the Consumer and notified by the Producer (and the
+    //  reverse for _writeWait.)  Each is on its own cache line as the
+    //  notifying side reads it after every publish.
+    alignas(kCacheLineSize) WaitStrategy _readWait;
+    alignas(kCacheLineSize) WaitStrategy _writeWait;
+    std::atomic<bool> _closed;
 };
 
 inline bool PacketBuffer::empty() const
 {
-    return _readIndex == _writeIndex;
+    return _index.empty();
+}
+
+inline bool PacketBuffer::closed() const
+{
+    return _closed.load(std::memory_order_acquire);
+}
+
+inline bool PacketBuffer::full() const
+{
+    return _index.full();
+}
+
+//  Mirrored indices past the end of the array land in the mirrored data.
+inline uint8_t* PacketBuffer::packetData(uint32_t index)
+{
+    return _byteBuffer.data() + (size_t)index * _packetStride;
+}
+
+inline uint32_t PacketBuffer::contiguousCount(uint32_t index) const
+{
+    return mirrored() ? _packetCapacity : _packetCapacity - index;
 }
 
-inline uint32_t PacketBuffer::nextWriteIndex() const
+//  When mirrored, an index past the end of the array is left pointing into
+//  the mirrored descriptors, which commitWrite copies back down.
+inline uint32_t PacketBuffer::skipIndex(uint32_t index, uint32_t skipCount) const
 {
-    return (_writeIndex + 1) % _packets.size();
+    index += skipCount;
+    if (index >= _packetCapacity && !mirrored())
+        index -= _packetCapacity;
+    return index;
 }
 
 
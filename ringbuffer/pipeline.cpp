@@ -0,0 +1,302 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "pipeline.hpp"
+
+#include <iostream>
+
+Pipeline::Pipeline(StreamInput& input, uint32_t packetDataSize,
+                   uint32_t capacity, WaitStrategy::Policy waitPolicy) :
+    _input(input),
+    _output(nullptr),
+    _waitPolicy(waitPolicy),
+    _inputActive(false),
+    _outputActive(false),
+    _result(0),
+    _inputThread(0),
+    _outputThread(0),
+    _inputStarted(false),
+    _outputStarted(false),
+    _started(false)
+{
+    pthread_mutex_init(&_resultMutex, NULL);
+    _buffers.emplace_back(new PacketBuffer(packetDataSize, capacity,
+                                           RingStorage::kHeap, waitPolicy));
+}
+
+Pipeline::~Pipeline()
+{
+    closeAll();
+    if (_inputStarted)
+        pthread_join(_inputThread, NULL);
+    for (auto& stage : _stages)
+    {
+        for (pthread_t thread : stage->threads)
+        {
+            pthread_join(thread, NULL);
+        }
+    }
+    if (_outputStarted)
+        pthread_join(_outputThread, NULL);
+    for (auto& stage : _stages)
+    {
+        pthread_cond_destroy(&stage->completed);
+        pthread_mutex_destroy(&stage->mutex);
+    }
+    pthread_mutex_destroy(&_resultMutex);
+}
+
+void Pipeline::addStage(PipelineStage& stage, uint32_t threadCount,
+                        uint32_t packetDataSize, uint32_t capacity)
+{
+    _buffers.emplace_back(new PacketBuffer(packetDataSize, capacity,
+                                           RingStorage::kHeap, _waitPolicy));
+
+    Stage* entry = new Stage;
+    entry->pipeline = this;
+    entry->stage = &stage;
+    entry->input = _buffers[_buffers.size() - 2].get();
+    entry->output = _buffers.back().get();
+    entry->threadCount = threadCount ? threadCount : 1;
+    pthread_mutex_init(&entry->mutex, NULL);
+    pthread_cond_init(&entry->completed, NULL);
+    entry->activeThreads = 0;
+    entry->claimed = 0;
+    entry->claimSequence = 0;
+    entry->done.resize(entry->input->capacity());
+    entry->transforming = 0;
+    entry->stopped = false;
+    _stages.emplace_back(entry);
+}
+
+bool Pipeline::start(StreamOutput& output)
+{
+    if (_started)
+        return false;
+    _output = &output;
+    _started = true;
+    _inputActive = true;
+    _outputActive = true;
+
+    //  if a thread can't be started, every buffer is closed so that the
+    //  threads already running stop, and only those are joined.
+    for (auto& stage : _stages)
+    {
+        stage->activeThreads = stage->threadCount;
+        stage->threads.reserve(stage->threadCount);
+        for (uint32_t i = 0; i < stage->threadCount; ++i)
+        {
+            pthread_t thread;
+            int res = pthread_create(&thread, NULL, Pipeline::stage_thread,
+                                     stage.get());
+            if (res)
+            {
+                std::cout << "pthread_create(stage) failed: " << res << std::endl;
+                closeAll();
+                _inputActive = _outputActive = false;
+                return false;
+            }
+            stage->threads.push_back(thread);
+        }
+    }
+    int res = pthread_create(&_outputThread, NULL, Pipeline::output_thread, this);
+    if (res)
+    {
+        std::cout << "pthread_create(output) failed: " << res << std::endl;
+        closeAll();
+        _inputActive = _outputActive = false;
+        return false;
+    }
+    _outputStarted = true;
+    res = pthread_create(&_inputThread, NULL, Pipeline::input_thread, this);
+    if (res)
+    {
+        std::cout << "pthread_create(input) failed: " << res << std::endl;
+        closeAll();
+        _inputActive = false;
+        return false;
+    }
+    _inputStarted = true;
+    return true;
+}
+
+bool Pipeline::active() const
+{
+    return _inputActive || _outputActive;
+}
+
+size_t Pipeline::outputCount() const
+{
+    return _output ? _output->outputCount() : 0;
+}
+
+void Pipeline::closeAll()
+{
+    for (auto& buffer : _buffers)
+    {
+        buffer->close();
+    }
+}
+
+void Pipeline::setResult(int result)
+{
+    if (!result)
+        return;
+    pthread_mutex_lock(&_resultMutex);
+    if (!_result)
+        _result = result;
+    pthread_mutex_unlock(&_resultMutex);
+}
+
+void* Pipeline::input_thread(void* arg)
+{
+    Pipeline* pipeline = reinterpret_cast<Pipeline*>(arg);
+    PacketBuffer& buffer = *pipeline->_buffers.front();
+    int result = pipeline->_input.produce(buffer);
+    pipeline->setResult(result);
+
+    pipeline->_inputActive = false;
+    buffer.close();
+    return nullptr;
+}
+
+void* Pipeline::output_thread(void* arg)
+{
+    Pipeline* pipeline = reinterpret_cast<Pipeline*>(arg);
+    PacketBuffer& buffer = *pipeline->_buffers.back();
+    int result = pipeline->_output->consume(buffer);
+    pipeline->setResult(result);
+
+    //  a failed output stops the whole pipeline, not just the last stage.
+    if (result)
+        pipeline->closeAll();
+    pipeline->_outputActive = false;
+    buffer.close();
+    return nullptr;
+}
+
+void* Pipeline::stage_thread(void* arg)
+{
+    Stage* stage = reinterpret_cast<Stage*>(arg);
+    stage->pipeline->runStage(*stage);
+    return nullptr;
+}
+
+//  The stage's threads are together the single Consumer of the input buffer
+//  and the single Producer of the output buffer, so every buffer call is
+//  made under the stage mutex.  Waits on the buffers are made without it.
+//
+//  A thread that finds nothing to claim while its siblings hold claims
+//  waits for one of them to complete instead of on the buffers - the
+//  buffers' wait conditions don't account for claimed packets.
+//
+void Pipeline::runStage(Stage& stage)
+{
+    PacketBuffer& input = *stage.input;
+    PacketBuffer& output = *stage.output;
+    const uint32_t doneSize = (uint32_t)stage.done.size();
+
+    pthread_mutex_lock(&stage.mutex);
+    for (;;)
+    {
+        if (stage.stopped || output.closed())
+        {
+            //  downstream has stopped, so stop upstream as well.
+            stage.stopped = true;
+            input.close();
+            break;
+        }
+
+        ConstPacketSpan readFrom = input.peekRead(1, stage.claimed);
+        PacketSpan writeTo = { nullptr, 0 };
+        if (readFrom.count)
+            writeTo = output.reserveWrite(1, stage.claimed);
+
+        if (writeTo.count)
+        {
+            uint64_t sequence = stage.claimSequence++;
+            stage.done[sequence % doneSize] = 0;
+            ++stage.claimed;
+            ++stage.transforming;
+            pthread_mutex_unlock(&stage.mutex);
+
+            int result = stage.stage->transform(readFrom.packets[0],
+                                                &writeTo.packets[0]);
+
+            pthread_mutex_lock(&stage.mutex);
+            --stage.transforming;
+            if (result)
+            {
+                //  the failed packet stays undone, so only the packets ahead
+                //  of it are committed.
+                stage.pipeline->setResult(result);
+                stage.stopped = true;
+                output.close();
+                pthread_cond_broadcast(&stage.completed);
+                continue;
+            }
+            stage.done[sequence % doneSize] = 1;
+
+            //  commit the completed packets at the head, in order.
+            uint64_t head = stage.claimSequence - stage.claimed;
+            uint32_t count = 0;
+            while (count < stage.claimed && stage.done[(head + count) % doneSize])
+                ++count;
+            if (count)
+            {
+                output.commitWrite(count);
+                input.releaseRead(count);
+                stage.claimed -= count;
+            }
+            pthread_cond_broadcast(&stage.completed);
+            continue;
+        }
+
+        if (stage.claimed)
+        {
+            pthread_cond_wait(&stage.completed, &stage.mutex);
+            continue;
+        }
+
+        //  nothing claimed - wait on whichever buffer held us up.
+        pthread_mutex_unlock(&stage.mutex);
+        bool ready = readFrom.count ? output.waitForWrite() : input.waitForRead();
+        pthread_mutex_lock(&stage.mutex);
+        if (!ready && !readFrom.count)
+        {
+            //  the input is closed and drained.
+            break;
+        }
+    }
+
+    //  the last thread out closes the output, once every claim is committed
+    //  (or, after a failure, no longer being transformed.)
+    while (stage.stopped ? stage.transforming : stage.claimed)
+        pthread_cond_wait(&stage.completed, &stage.mutex);
+    bool last = --stage.activeThreads == 0;
+    pthread_cond_broadcast(&stage.completed);
+    pthread_mutex_unlock(&stage.mutex);
+    if (last)
+        output.close();
+}
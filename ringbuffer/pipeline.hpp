@@ -0,0 +1,142 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_Pipeline_hpp
+#define CK_Sample_Pipeline_hpp
+
+#include "streamer.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <pthread.h>
+
+//  A transform applied to every packet passing through a Pipeline stage.
+//
+class PipelineStage
+{
+public:
+    virtual ~PipelineStage() {}
+
+    //  Transforms input into output.  The output's size starts at its
+    //  buffer's packet data size and should be set to the size written.
+    //  When the stage runs on more than one thread, transform is called
+    //  concurrently for different packets.  Returns 0 on success, or a
+    //  nonzero error code to stop the pipeline.
+    virtual int transform(const Packet& input, Packet* output) = 0;
+};
+
+//  Chains a StreamInput through any number of PipelineStages to a
+//  StreamOutput, with a PacketBuffer between each pair of neighbours.
+//
+//  As with the Streamer, the input and output each run on their own thread.
+//  Each stage runs on a pool of one or more threads, so CPU heavy stages
+//  (checksums, compression, transcoding) overlap with I/O and with each
+//  other.  A stage's threads share its input and output buffers - a thread
+//  claims the next input packet along with an output packet under the
+//  stage's mutex, transforms it without holding the mutex, and completed
+//  packets are committed downstream in their original order.
+//
+//  Backpressure flows upstream through the buffers: a stage whose output is
+//  full stops claiming input, which in turn fills its input buffer.  Closing
+//  flows both ways - once the input finishes, each stage closes its output
+//  after draining its input, and if the output (or a stage) fails, buffers
+//  are closed upstream to stop the earlier stages.
+//
+class Pipeline
+{
+public:
+    Pipeline(StreamInput& input, uint32_t packetDataSize, uint32_t capacity,
+             WaitStrategy::Policy waitPolicy=WaitStrategy::kBlocking);
+    ~Pipeline();
+
+    //  Appends a stage writing to a new buffer of the given packet size and
+    //  capacity.  Stages must be added before start().
+    void addStage(PipelineStage& stage, uint32_t threadCount,
+                  uint32_t packetDataSize, uint32_t capacity);
+
+    //  Starts all threads, with the last stage's buffer drained to output.
+    bool start(StreamOutput& output);
+
+    bool active() const;
+
+    size_t outputCount() const;
+
+    //  The first nonzero result from the input, a stage or the output.
+    int result() const { return _result; }
+
+private:
+    struct Stage
+    {
+        Pipeline* pipeline;
+        PipelineStage* stage;
+        PacketBuffer* input;
+        PacketBuffer* output;
+        uint32_t threadCount;
+        //  the threads actually started
+        std::vector<pthread_t> threads;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t completed;
+        uint32_t activeThreads;
+        //  claimed packets not yet committed, and whether each is done
+        //  (indexed by claim sequence % size.)  A packet whose transform
+        //  failed is never done, so nothing from it on is committed.
+        uint32_t claimed;
+        uint64_t claimSequence;
+        std::vector<uint8_t> done;
+        //  claimed packets still being transformed
+        uint32_t transforming;
+        bool stopped;
+    };
+
+    static void* input_thread(void* arg);
+    static void* stage_thread(void* arg);
+    static void* output_thread(void* arg);
+
+    void runStage(Stage& stage);
+    void setResult(int result);
+    void closeAll();
+
+    StreamInput& _input;
+    StreamOutput* _output;
+    WaitStrategy::Policy _waitPolicy;
+
+    std::vector<std::unique_ptr<PacketBuffer>> _buffers;
+    std::vector<std::unique_ptr<Stage>> _stages;
+
+    volatile bool _inputActive;
+    volatile bool _outputActive;
+    volatile int _result;
+    pthread_mutex_t _resultMutex;
+
+    pthread_t _inputThread;
+    pthread_t _outputThread;
+    bool _inputStarted;
+    bool _outputStarted;
+    bool _started;
+};
+
+
+#endif
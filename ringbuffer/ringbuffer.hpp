@@ -0,0 +1,157 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_RingBuffer_hpp
+#define CK_Sample_RingBuffer_hpp
+
+#include "ringindex.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//  A single Producer, single Consumer ring of typed, fixed size records.
+//
+//  Where the PacketBuffer moves bytes between its packets and the caller's
+//  buffers, the RingBuffer constructs each record in place in its slot with
+//  emplace, and the Consumer either works on the record where it sits
+//  (front, then pop) or moves it out (take.)  Slots are raw storage aligned
+//  for T - a record is only alive between its emplace and its pop or take.
+//
+//  Synchronization is the PacketBuffer's RingIndex.  There is no waiting -
+//  callers poll, or pair the buffer with a WaitStrategy.
+//
+template<typename T>
+class RingBuffer
+{
+public:
+    //  The capacity is rounded up to a power of two.
+    RingBuffer(uint32_t capacity);
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    uint32_t capacity() const { return _index.capacity(); }
+    bool empty() const { return _index.empty(); }
+    bool full() const { return _index.full(); }
+
+    //  Consumer methods
+    //  The record at the read head, or nullptr if the buffer is empty.
+    T* front();
+    //  Destroys the record at the read head.  Returns false if empty.
+    bool pop();
+    //  Moves the record at the read head into value, then destroys it.
+    //  Returns false if empty.
+    bool take(T& value);
+
+    //  Producer methods
+    //  Constructs a record from args at the write head.  Returns false if the
+    //  buffer is full, in which case nothing is constructed.
+    template<typename... Args> bool emplace(Args&&... args);
+    bool push(const T& value) { return emplace(value); }
+    bool push(T&& value) { return emplace(std::move(value)); }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    T* slot(uint32_t index);
+
+    RingIndex _index;
+    Slot* _slots;
+};
+
+template<typename T>
+RingBuffer<T>::RingBuffer(uint32_t capacity) :
+    _index(roundUpToPowerOf2(capacity < 2 ? 2 : capacity)),
+    _slots(nullptr)
+{
+    //  posix_memalign honors alignments beyond that of malloc.
+    size_t alignment = alignof(Slot) < sizeof(void*) ? sizeof(void*) : alignof(Slot);
+    void* slots = nullptr;
+    if (posix_memalign(&slots, alignment, sizeof(Slot) * _index.capacity()) == 0)
+        _slots = reinterpret_cast<Slot*>(slots);
+}
+
+template<typename T>
+RingBuffer<T>::~RingBuffer()
+{
+    if (!_slots)
+        return;
+    while (pop())
+        ;
+    free(_slots);
+}
+
+template<typename T>
+inline T* RingBuffer<T>::slot(uint32_t index)
+{
+    return reinterpret_cast<T*>(&_slots[index]);
+}
+
+template<typename T>
+T* RingBuffer<T>::front()
+{
+    if (!_index.readable(1))
+        return nullptr;
+    return slot(_index.readIndex());
+}
+
+template<typename T>
+bool RingBuffer<T>::pop()
+{
+    T* record = front();
+    if (!record)
+        return false;
+    record->~T();
+    _index.releaseRead(1);
+    return true;
+}
+
+template<typename T>
+bool RingBuffer<T>::take(T& value)
+{
+    T* record = front();
+    if (!record)
+        return false;
+    value = std::move(*record);
+    record->~T();
+    _index.releaseRead(1);
+    return true;
+}
+
+template<typename T>
+template<typename... Args>
+bool RingBuffer<T>::emplace(Args&&... args)
+{
+    if (!_slots || !_index.writable(1))
+        return false;
+    new(slot(_index.writeIndex())) T(std::forward<Args>(args)...);
+    _index.commitWrite(1);
+    return true;
+}
+
+
+#endif
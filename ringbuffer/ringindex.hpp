@@ -0,0 +1,196 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_RingIndex_hpp
+#define CK_Sample_RingIndex_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//  Used to keep state owned by one side of the buffer off of the cache line
+//  owned by the other side.
+const size_t kCacheLineSize = 64;
+
+inline uint32_t roundUpToPowerOf2(uint32_t value)
+{
+    --value;
+    value |= value >> 1;
+    value |= value >> 2;
+    value |= value >> 4;
+    value |= value >> 8;
+    value |= value >> 16;
+    return value + 1;
+}
+
+//  The read and write positions of a single Producer, single Consumer ring.
+//
+//  Positions are monotonically increasing 64-bit sequence numbers - the
+//  number of entries ever written (or read) - so (write - read) is the
+//  number of entries in the ring, and every slot of the ring is usable.  A
+//  sequence's slot is the sequence masked by the capacity when the capacity
+//  is a power of two, or the sequence modulo the capacity otherwise.
+//
+//  The write sequence is published by the Producer with release semantics
+//  and read by the Consumer with acquire semantics (and vice-versa for the
+//  read sequence.)  Each side keeps a cached copy of the other side's
+//  sequence and only reloads the shared sequence when the cached copy can't
+//  satisfy a request, which keeps the two cache lines from bouncing between
+//  cores on every operation.
+//
+class RingIndex
+{
+public:
+    RingIndex(uint32_t capacity);
+
+    uint32_t capacity() const { return _capacity; }
+
+    //  Safe to call from either side, though empty() is only stable for the
+    //  Consumer and full() for the Producer.
+    bool empty() const;
+    bool full() const;
+
+    //  The sequence numbers of the next entry to be read and written.  Safe
+    //  to call from either side - the Consumer's lag behind the Producer is
+    //  writeSequence() - readSequence().
+    uint64_t readSequence() const;
+    uint64_t writeSequence() const;
+
+    //  The slot holding the entry with the given sequence number.
+    uint32_t slot(uint64_t sequence) const;
+
+    //  Consumer methods
+    //  The slot at the read head.
+    uint32_t readIndex() const;
+    //  Returns the number of readable entries.  The Producer's sequence is
+    //  only reloaded if fewer than wanted are known to be readable.
+    uint32_t readable(uint32_t wanted);
+    void releaseRead(uint32_t count);
+
+    //  Producer methods
+    //  The slot at the write head.
+    uint32_t writeIndex() const;
+    //  Returns the number of writable slots.  The Consumer's sequence is only
+    //  reloaded if fewer than wanted are known to be writable.
+    uint32_t writable(uint32_t wanted);
+    void commitWrite(uint32_t count);
+
+private:
+    const uint32_t _capacity;
+    //  capacity - 1 for power of two capacities, zero otherwise.
+    const uint32_t _mask;
+
+    //  Producer owned - _writeSequence is shared with the Consumer.
+    alignas(kCacheLineSize) std::atomic<uint64_t> _writeSequence;
+    uint64_t _readSequenceCache;
+    //  Consumer owned - _readSequence is shared with the Producer.
+    alignas(kCacheLineSize) std::atomic<uint64_t> _readSequence;
+    uint64_t _writeSequenceCache;
+};
+
+inline RingIndex::RingIndex(uint32_t capacity) :
+    _capacity(capacity),
+    _mask(capacity > 1 && !(capacity & (capacity - 1)) ? capacity - 1 : 0),
+    _writeSequence(0),
+    _readSequenceCache(0),
+    _readSequence(0),
+    _writeSequenceCache(0)
+{
+}
+
+inline bool RingIndex::empty() const
+{
+    return _readSequence.load(std::memory_order_relaxed) ==
+           _writeSequence.load(std::memory_order_acquire);
+}
+
+inline bool RingIndex::full() const
+{
+    return _writeSequence.load(std::memory_order_relaxed) -
+           _readSequence.load(std::memory_order_acquire) == _capacity;
+}
+
+inline uint64_t RingIndex::readSequence() const
+{
+    return _readSequence.load(std::memory_order_acquire);
+}
+
+inline uint64_t RingIndex::writeSequence() const
+{
+    return _writeSequence.load(std::memory_order_acquire);
+}
+
+inline uint32_t RingIndex::slot(uint64_t sequence) const
+{
+    return _mask ? (uint32_t)(sequence & _mask) : (uint32_t)(sequence % _capacity);
+}
+
+inline uint32_t RingIndex::readIndex() const
+{
+    return slot(_readSequence.load(std::memory_order_relaxed));
+}
+
+inline uint32_t RingIndex::readable(uint32_t wanted)
+{
+    uint64_t readSequence = _readSequence.load(std::memory_order_relaxed);
+    uint32_t available = (uint32_t)(_writeSequenceCache - readSequence);
+    if (available < wanted)
+    {
+        _writeSequenceCache = _writeSequence.load(std::memory_order_acquire);
+        available = (uint32_t)(_writeSequenceCache - readSequence);
+    }
+    return available;
+}
+
+inline void RingIndex::releaseRead(uint32_t count)
+{
+    uint64_t readSequence = _readSequence.load(std::memory_order_relaxed);
+    _readSequence.store(readSequence + count, std::memory_order_release);
+}
+
+inline uint32_t RingIndex::writeIndex() const
+{
+    return slot(_writeSequence.load(std::memory_order_relaxed));
+}
+
+inline uint32_t RingIndex::writable(uint32_t wanted)
+{
+    uint64_t writeSequence = _writeSequence.load(std::memory_order_relaxed);
+    uint32_t available = _capacity - (uint32_t)(writeSequence - _readSequenceCache);
+    if (available < wanted)
+    {
+        _readSequenceCache = _readSequence.load(std::memory_order_acquire);
+        available = _capacity - (uint32_t)(writeSequence - _readSequenceCache);
+    }
+    return available;
+}
+
+inline void RingIndex::commitWrite(uint32_t count)
+{
+    uint64_t writeSequence = _writeSequence.load(std::memory_order_relaxed);
+    _writeSequence.store(writeSequence + count, std::memory_order_release);
+}
+
+
+#endif
@@ -0,0 +1,285 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ringstorage.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#endif
+
+static size_t roundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+RingStorage::RingStorage(size_t size, Type type, const RingAllocation& allocation) :
+    _type(type),
+    _data(nullptr),
+    _size(size),
+    _mappedSize(0)
+{
+    if (_type == kMirrored)
+    {
+        bool mapped = false;
+        if (allocation.flags & RingAllocation::kExplicitHugePages)
+        {
+            mapped = mapMirrored(allocation, true);
+            if (!mapped)
+            {
+                std::cout << "RingStorage: explicit huge pages unavailable for a mirrored "
+                          << size << " byte ring" << std::endl;
+            }
+        }
+        if (!mapped && !mapMirrored(allocation, false))
+        {
+            std::cout << "RingStorage: mirrored mapping of " << size
+                      << " bytes unavailable, using heap storage" << std::endl;
+            _type = kHeap;
+        }
+    }
+    if (_type == kHeap && _size)
+    {
+        if (allocation.flags || allocation.slotAlignment || allocation.numaNode >= 0)
+            mapHeap(allocation);
+        if (!_data)
+            _data = (uint8_t*)calloc(_size, 1);
+    }
+    if (_data && (allocation.flags & RingAllocation::kPrefault))
+        prefault();
+}
+
+RingStorage::~RingStorage()
+{
+    if (!_data)
+        return;
+
+#if defined(__linux__)
+    if (_type == kMirrored)
+    {
+        munmap(_data, _size * 2);
+        return;
+    }
+    if (_mappedSize)
+    {
+        munmap(_data, _mappedSize);
+        return;
+    }
+#endif
+    free(_data);
+}
+
+size_t RingStorage::pageSize()
+{
+    return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+//  The default huge page size on x86-64 and arm64 (4 KB base pages.)
+//
+size_t RingStorage::hugePageSize()
+{
+    return 2 * 1024 * 1024;
+}
+
+void RingStorage::prefault()
+{
+    if (!_data)
+        return;
+#if defined(__linux__)
+    //  faults in the whole range with one call on Linux 5.14 and later.
+    //  Only page aligned (mapped) storage qualifies.
+    if (_type == kMirrored || _mappedSize)
+    {
+        if (!madvise(_data, _type == kMirrored ? _size : _mappedSize,
+                     MADV_POPULATE_WRITE))
+            return;
+    }
+#endif
+    volatile uint8_t* data = _data;
+    size_t page = pageSize();
+    for (size_t offset = 0; offset < _size; offset += page)
+        data[offset] = data[offset];
+}
+
+//  Maps anonymous memory for heap storage - trimming an oversized
+//  reservation down to a huge page boundary so that transparent huge pages
+//  can back the whole ring.
+//
+bool RingStorage::mapHeap(const RingAllocation& allocation)
+{
+#if defined(__linux__)
+    const int protection = PROT_READ | PROT_WRITE;
+    const int mapping = MAP_PRIVATE | MAP_ANONYMOUS;
+    bool hugePages = (allocation.flags & (RingAllocation::kHugePages |
+                                          RingAllocation::kExplicitHugePages)) != 0;
+    size_t length = roundUp(_size, hugePages ? hugePageSize() : pageSize());
+    uint8_t* data = nullptr;
+
+    if (allocation.flags & RingAllocation::kExplicitHugePages)
+    {
+        void* mapped = mmap(NULL, length, protection, mapping | MAP_HUGETLB, -1, 0);
+        if (mapped != MAP_FAILED)
+            data = (uint8_t*)mapped;
+        else
+            std::cout << "RingStorage: explicit huge pages unavailable, "
+                         "using transparent huge pages" << std::endl;
+    }
+    if (!data)
+    {
+        size_t reserve = hugePages ? length + hugePageSize() : length;
+        void* mapped = mmap(NULL, reserve, protection, mapping, -1, 0);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = (uint8_t*)mapped;
+        if (hugePages)
+        {
+            uint8_t* aligned = (uint8_t*)roundUp((size_t)data, hugePageSize());
+            if (aligned != data)
+                munmap(data, aligned - data);
+            if (aligned + length != data + reserve)
+                munmap(aligned + length, (data + reserve) - (aligned + length));
+            data = aligned;
+            if (madvise(data, length, MADV_HUGEPAGE))
+                std::cout << "RingStorage: transparent huge pages unavailable" << std::endl;
+        }
+    }
+    _data = data;
+    _mappedSize = length;
+    bindToNode(allocation.numaNode);
+    return true;
+#else
+    //  no mapping options - just honor the alignment.
+    size_t alignment = allocation.slotAlignment > sizeof(void*) ?
+        allocation.slotAlignment : sizeof(void*);
+    void* data = nullptr;
+    if (posix_memalign(&data, alignment, _size))
+        return false;
+    memset(data, 0, _size);
+    _data = (uint8_t*)data;
+    return true;
+#endif
+}
+
+//  Reserves twice the storage size in address space, then maps the same
+//  memfd over each half.  Explicit huge pages need a huge page sized ring
+//  and a huge page aligned reservation.
+//
+bool RingStorage::mapMirrored(const RingAllocation& allocation, bool explicitHugePages)
+{
+#if defined(__linux__)
+    size_t alignment = explicitHugePages ? hugePageSize() : pageSize();
+    if (!_size || (_size % alignment) != 0)
+        return false;
+
+    int fd = memfd_create("ringstorage",
+                          MFD_CLOEXEC | (explicitHugePages ? MFD_HUGETLB : 0));
+    if (fd < 0)
+        return false;
+
+    uint8_t* base = nullptr;
+    if (ftruncate(fd, (off_t)_size) == 0)
+    {
+        size_t reserve = _size * 2 + (explicitHugePages ? alignment : 0);
+        void* reserved = mmap(NULL, reserve, PROT_NONE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved != MAP_FAILED)
+        {
+            uint8_t* start = (uint8_t*)reserved;
+            base = (uint8_t*)roundUp((size_t)start, alignment);
+            if (base != start)
+                munmap(start, base - start);
+            if (base + _size * 2 != start + reserve)
+                munmap(base + _size * 2, (start + reserve) - (base + _size * 2));
+
+            void* lower = mmap(base, _size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_FIXED, fd, 0);
+            void* upper = mmap(base + _size, _size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_FIXED, fd, 0);
+            if (lower == MAP_FAILED || upper == MAP_FAILED)
+            {
+                munmap(base, _size * 2);
+                base = nullptr;
+            }
+        }
+    }
+    //  the mappings keep the memory alive
+    close(fd);
+
+    _data = base;
+    if (!_data)
+        return false;
+
+    //  transparent huge pages for shared memory also depend on the system's
+    //  shmem_enabled setting.
+    if (!explicitHugePages && (allocation.flags & RingAllocation::kHugePages))
+        madvise(_data, _size * 2, MADV_HUGEPAGE);
+    //  the policy applies to the memfd's pages, so binding either half
+    //  binds both.
+    bindToNode(allocation.numaNode);
+    return true;
+#else
+    (void)allocation;
+    (void)explicitHugePages;
+    return false;
+#endif
+}
+
+//  Prefers the node for pages not yet faulted in, without requiring libnuma.
+//  Must run before the storage is first touched.
+//
+void RingStorage::bindToNode(int numaNode)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const int kPolicyPreferred = 1;     // MPOL_PREFERRED
+    const int kMaxNodes = 1024;
+    if (numaNode < 0)
+        return;
+    if (numaNode >= kMaxNodes)
+    {
+        std::cout << "RingStorage: NUMA node " << numaNode << " out of range" << std::endl;
+        return;
+    }
+    const int kBitsPerWord = sizeof(unsigned long) * 8;
+    unsigned long nodeMask[kMaxNodes / kBitsPerWord] = { 0 };
+    nodeMask[numaNode / kBitsPerWord] = 1UL << (numaNode % kBitsPerWord);
+    size_t length = _type == kMirrored ? _size : _mappedSize;
+    if (syscall(SYS_mbind, _data, length, kPolicyPreferred,
+                nodeMask, (unsigned long)kMaxNodes, 0) != 0)
+    {
+        std::cout << "RingStorage: unable to bind to NUMA node " << numaNode << std::endl;
+    }
+#else
+    (void)numaNode;
+#endif
+}
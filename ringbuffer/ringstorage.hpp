@@ -0,0 +1,120 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_RingStorage_hpp
+#define CK_Sample_RingStorage_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+//  How a RingStorage's memory is allocated and placed.
+//
+//  Huge pages cut the TLB misses of walking a large ring.  Slot alignment
+//  is applied by rings of fixed size slots (see PacketBuffer), padding each
+//  slot to a power of two boundary such as a cache line or a page.  Binding
+//  to a NUMA node keeps a ring on the node of the thread that uses it most,
+//  and prefaulting moves every page fault out of the streaming hot path.
+//
+struct RingAllocation
+{
+    enum
+    {
+        //  Back the storage with transparent huge pages (madvise.)
+        kHugePages          = 0x0001,
+        //  Map the storage from the explicit huge page pool (MAP_HUGETLB),
+        //  falling back to kHugePages if the pool is exhausted.
+        kExplicitHugePages  = 0x0002,
+        //  Touch every page at construction.
+        kPrefault           = 0x0004
+    };
+
+    uint32_t flags;
+    //  The alignment of each slot in bytes (a power of two, up to the page
+    //  size), or 0 to pack slots end to end.
+    uint32_t slotAlignment;
+    //  The NUMA node preferred for the memory, or -1 to leave placement to
+    //  the first thread to touch each page.
+    int numaNode;
+
+    RingAllocation() : flags(0), slotAlignment(0), numaNode(-1) {}
+};
+
+//  The memory backing a ring buffer.
+//
+//  kHeap storage is a plain heap allocation.
+//
+//  kMirrored storage (Linux only) maps the same memory twice, back to back in
+//  virtual memory, so that data + size aliases data.  Any range of up to
+//  size() bytes starting within the ring is contiguous, even if it wraps
+//  past the end of the ring.  Mirroring requires size to be a multiple of
+//  the page size - if it isn't, or mirroring isn't available on the
+//  platform, the storage falls back to kHeap (check type() after
+//  construction.)
+//
+//  Any RingAllocation options move heap storage from calloc to its own
+//  anonymous mapping, which is page aligned (huge page aligned when using
+//  huge pages.)  Options that aren't available are reported and skipped.
+//
+class RingStorage
+{
+public:
+    enum Type
+    {
+        kHeap,
+        kMirrored
+    };
+
+    RingStorage(size_t size, Type type,
+                const RingAllocation& allocation=RingAllocation());
+    ~RingStorage();
+
+    RingStorage(const RingStorage&) = delete;
+    RingStorage& operator=(const RingStorage&) = delete;
+
+    Type type() const { return _type; }
+    uint8_t* data() { return _data; }
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+
+    //  Faults in every page of the storage.  Called by the thread that
+    //  should own the memory when placement is left to first touch.
+    void prefault();
+
+    static size_t pageSize();
+    static size_t hugePageSize();
+
+private:
+    bool mapHeap(const RingAllocation& allocation);
+    bool mapMirrored(const RingAllocation& allocation, bool explicitHugePages);
+    void bindToNode(int numaNode);
+
+    Type _type;
+    uint8_t* _data;
+    size_t _size;
+    //  The length of a kHeap mapping, or 0 if _data came from the heap.
+    size_t _mappedSize;
+};
+
+
+#endif
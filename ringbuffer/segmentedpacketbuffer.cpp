@@ -0,0 +1,298 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "segmentedpacketbuffer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+OccupancyResizePolicy::OccupancyResizePolicy(uint32_t minCapacity,
+                                             uint32_t maxCapacity,
+                                             uint32_t growStalls,
+                                             uint32_t shrinkWindowUs) :
+    _minCapacity(minCapacity),
+    _maxCapacity(maxCapacity),
+    _growStalls(growStalls),
+    _shrinkWindow(shrinkWindowUs),
+    _stallCount(0),
+    _lastStall(std::chrono::steady_clock::now()),
+    _lastBusy(_lastStall)
+{
+}
+
+uint32_t OccupancyResizePolicy::resizeFull(uint32_t capacity)
+{
+    auto now = std::chrono::steady_clock::now();
+    //  stalls separated by a quiet stretch don't add up
+    if (now - _lastStall >= _shrinkWindow)
+        _stallCount = 0;
+    _lastStall = now;
+    _lastBusy = now;
+    if (++_stallCount < _growStalls || capacity >= _maxCapacity)
+        return capacity;
+    _stallCount = 0;
+    return capacity > _maxCapacity / 2 ? _maxCapacity : capacity * 2;
+}
+
+uint32_t OccupancyResizePolicy::resizeIdle(uint32_t capacity, uint32_t occupancy)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (occupancy >= capacity / 4)
+    {
+        _lastBusy = now;
+        return capacity;
+    }
+    if (capacity <= _minCapacity || now - _lastBusy < _shrinkWindow)
+        return capacity;
+    //  the next halving needs another quiet window
+    _lastBusy = now;
+    return std::max(capacity / 2, _minCapacity);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SegmentedPacketBuffer::Segment::Segment(uint32_t packetDataSize,
+                                        uint32_t packetCapacity) :
+    index(packetCapacity),
+    storage((size_t)packetDataSize*packetCapacity, RingStorage::kHeap),
+    packets(packetCapacity),
+    next(nullptr)
+{
+    uint8_t* packetData = storage.data();
+    for (auto& packet : packets)
+    {
+        packet.data = packetData;
+        packet.size = 0;
+        packet.checksum = 0;
+        packetData += packetDataSize;
+    }
+}
+
+void* SegmentedPacketBuffer::Segment::operator new(size_t size) noexcept
+{
+    void* p = nullptr;
+    if (posix_memalign(&p, kCacheLineSize, size))
+        return nullptr;
+    return p;
+}
+
+void SegmentedPacketBuffer::Segment::operator delete(void* p)
+{
+    free(p);
+}
+
+SegmentedPacketBuffer::SegmentedPacketBuffer(uint32_t packetDataSize,
+                                             uint32_t packetCapacity,
+                                             ResizePolicy* resizePolicy,
+                                             WaitStrategy::Policy waitPolicy) :
+    _packetDataSize(packetDataSize),
+    _resizePolicy(resizePolicy),
+    _writeSegment(new Segment(packetDataSize, packetCapacity)),
+    _capacity(packetCapacity),
+    _resizeCount(0),
+    _writeSequence(0),
+    _writeStalled(false),
+    _idleReservations(0),
+    _readSegment(_writeSegment),
+    _readSequence(0),
+    _readWait(waitPolicy),
+    _writeWait(waitPolicy),
+    _closed(false)
+{
+}
+
+SegmentedPacketBuffer::~SegmentedPacketBuffer()
+{
+    Segment* segment = _readSegment;
+    while (segment)
+    {
+        Segment* next = segment->next.load(std::memory_order_acquire);
+        delete segment;
+        segment = next;
+    }
+}
+
+void* SegmentedPacketBuffer::operator new(size_t size) noexcept
+{
+    void* p = nullptr;
+    if (posix_memalign(&p, kCacheLineSize, size))
+        return nullptr;
+    return p;
+}
+
+void SegmentedPacketBuffer::operator delete(void* p)
+{
+    free(p);
+}
+
+void SegmentedPacketBuffer::close()
+{
+    _closed.store(true, std::memory_order_release);
+    _readWait.notify();
+    _writeWait.notify();
+}
+
+//  Returns the segment holding the read head, first moving past (and
+//  freeing) segments the Producer has left that have no packets left.
+//
+auto SegmentedPacketBuffer::readSegment() -> Segment*
+{
+    Segment* segment = _readSegment;
+    for (;;)
+    {
+        if (segment->index.readable(1))
+            return segment;
+        Segment* next = segment->next.load(std::memory_order_acquire);
+        if (!next)
+            return segment;
+        //  the Producer's last commit to this segment happened before it
+        //  linked the next one, so look again before leaving.
+        if (segment->index.readable(1))
+            return segment;
+        delete segment;
+        segment = next;
+        _readSegment = segment;
+    }
+}
+
+bool SegmentedPacketBuffer::empty()
+{
+    return !readSegment()->index.readable(1);
+}
+
+bool SegmentedPacketBuffer::waitForRead()
+{
+    _readWait.wait([this]() -> bool { return !empty() || closed(); });
+    return !empty();
+}
+
+ConstPacketSpan SegmentedPacketBuffer::peekRead(uint32_t maxCount)
+{
+    ConstPacketSpan span = { nullptr, 0, _readSequence };
+    Segment* segment = readSegment();
+    uint32_t available = segment->index.readable(maxCount);
+    uint32_t readIndex = segment->index.readIndex();
+    span.count = std::min(std::min(available, maxCount),
+                          segment->index.capacity() - readIndex);
+    if (span.count)
+        span.packets = &segment->packets[readIndex];
+    return span;
+}
+
+void SegmentedPacketBuffer::releaseRead(uint32_t count)
+{
+    _readSegment->index.releaseRead(count);
+    _readSequence += count;
+    _writeWait.notify();
+}
+
+//  Consults the policy if the Producer just stalled on a full segment, or
+//  if it's been kIdleCheckInterval reservations since the last check.
+//
+void SegmentedPacketBuffer::applyPolicy()
+{
+    Segment* segment = _writeSegment;
+    uint32_t capacity = segment->index.capacity();
+    if (!segment->index.writable(1))
+    {
+        if (_writeStalled)
+            return;
+        _writeStalled = true;
+        resizeTo(_resizePolicy->resizeFull(capacity));
+        return;
+    }
+    _writeStalled = false;
+    if (++_idleReservations < kIdleCheckInterval)
+        return;
+    _idleReservations = 0;
+    uint32_t occupancy = (uint32_t)(segment->index.writeSequence() -
+                                    segment->index.readSequence());
+    resizeTo(_resizePolicy->resizeIdle(capacity, occupancy));
+}
+
+//  Links in a segment of the given capacity.  The current segment is left to
+//  the Consumer.
+//
+void SegmentedPacketBuffer::resizeTo(uint32_t capacity)
+{
+    Segment* segment = _writeSegment;
+    if (!capacity || capacity == segment->index.capacity())
+        return;
+
+    Segment* next = new Segment(_packetDataSize, capacity);
+    if (!next || !next->storage.data())
+    {
+        delete next;
+        return;
+    }
+    _writeSegment = next;
+    _writeStalled = false;
+    _capacity.store(capacity, std::memory_order_relaxed);
+    _resizeCount.fetch_add(1, std::memory_order_relaxed);
+    segment->next.store(next, std::memory_order_release);
+    _readWait.notify();
+}
+
+bool SegmentedPacketBuffer::writeFull()
+{
+    return !_writeSegment->index.writable(1);
+}
+
+bool SegmentedPacketBuffer::waitForWrite()
+{
+    if (_resizePolicy && writeFull())
+        applyPolicy();
+    _writeWait.wait([this]() -> bool { return !writeFull() || closed(); });
+    return !closed();
+}
+
+PacketSpan SegmentedPacketBuffer::reserveWrite(uint32_t maxCount)
+{
+    if (_resizePolicy)
+        applyPolicy();
+    PacketSpan span = { nullptr, 0, _writeSequence };
+    Segment* segment = _writeSegment;
+    uint32_t available = segment->index.writable(maxCount);
+    uint32_t writeIndex = segment->index.writeIndex();
+    span.count = std::min(std::min(available, maxCount),
+                          segment->index.capacity() - writeIndex);
+    if (span.count)
+    {
+        span.packets = &segment->packets[writeIndex];
+        for (uint32_t i = 0; i < span.count; ++i)
+        {
+            span.packets[i].data = segment->storage.data() +
+                                   (size_t)(writeIndex + i) * _packetDataSize;
+            span.packets[i].size = _packetDataSize;
+        }
+    }
+    return span;
+}
+
+void SegmentedPacketBuffer::commitWrite(uint32_t count)
+{
+    _writeSegment->index.commitWrite(count);
+    _writeSequence += count;
+    _readWait.notify();
+}
@@ -0,0 +1,207 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_SegmentedPacketBuffer_hpp
+#define CK_Sample_SegmentedPacketBuffer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//  Chooses the capacity of a SegmentedPacketBuffer as it runs.
+//
+//  Both methods return the capacity to continue with - returning a
+//  different capacity links in a new segment of that capacity.
+//
+class ResizePolicy
+{
+public:
+    virtual ~ResizePolicy() {}
+
+    //  Called by the Producer when it finds the segment being written full,
+    //  once per stall however often the Producer polls, with the segment's
+    //  capacity.
+    virtual uint32_t resizeFull(uint32_t capacity) = 0;
+    //  Called by the Producer every SegmentedPacketBuffer::kIdleCheckInterval
+    //  reservations that didn't find the segment full, with the segment's
+    //  capacity and the packets it holds that the Consumer hasn't released.
+    virtual uint32_t resizeIdle(uint32_t capacity, uint32_t occupancy) = 0;
+};
+
+//  Doubles the capacity once the Producer has stalled on a full ring
+//  growStalls times with no quiet stretch (shrinkWindowUs long) between the
+//  stalls, and halves it once the ring has stayed under a quarter full,
+//  without stalling, for shrinkWindowUs.  The capacity stays within
+//  [minCapacity, maxCapacity].
+//
+class OccupancyResizePolicy : public ResizePolicy
+{
+public:
+    OccupancyResizePolicy(uint32_t minCapacity, uint32_t maxCapacity,
+                          uint32_t growStalls=4, uint32_t shrinkWindowUs=100000);
+
+    uint32_t resizeFull(uint32_t capacity) override;
+    uint32_t resizeIdle(uint32_t capacity, uint32_t occupancy) override;
+
+private:
+    const uint32_t _minCapacity;
+    const uint32_t _maxCapacity;
+    const uint32_t _growStalls;
+    const std::chrono::microseconds _shrinkWindow;
+    uint32_t _stallCount;
+    std::chrono::steady_clock::time_point _lastStall;
+    //  when the ring was last a quarter full or more
+    std::chrono::steady_clock::time_point _lastBusy;
+};
+
+//  A single Producer, single Consumer ring whose capacity changes while it
+//  runs, so that memory follows demand instead of the worst case burst.
+//
+//  The ring is a chain of segments, each a fixed capacity ring of packets
+//  with its own storage.  To resize, the Producer links a new segment after
+//  the one it's writing and moves on to it - nothing is copied and neither
+//  side stops.  The Consumer finishes the packets left in the old segment,
+//  follows the link and frees the old segment.  Until then, both segments
+//  are allocated.
+//
+//  Resizing is decided by a ResizePolicy, consulted by the Producer in
+//  waitForWrite and reserveWrite - when it stalls on a full segment, and
+//  every kIdleCheckInterval reservations otherwise, so the policy stays off
+//  the Producer's fast path.  Without a policy the capacity stays as
+//  constructed.
+//
+//  The Producer and Consumer methods follow the PacketBuffer's.  Spans
+//  never cross a segment (or the end of a segment's packet array), and their
+//  sequence numbers count packets across all segments.
+//
+class SegmentedPacketBuffer
+{
+public:
+    //  Reservations between the policy's idle checks.
+    static const uint32_t kIdleCheckInterval = 256;
+
+    SegmentedPacketBuffer(uint32_t packetDataSize, uint32_t packetCapacity,
+                          ResizePolicy* resizePolicy=nullptr,
+                          WaitStrategy::Policy waitPolicy=WaitStrategy::kSpinYield);
+    ~SegmentedPacketBuffer();
+
+    SegmentedPacketBuffer(const SegmentedPacketBuffer&) = delete;
+    SegmentedPacketBuffer& operator=(const SegmentedPacketBuffer&) = delete;
+
+    //  Keeps heap allocated buffers cache line aligned.
+    static void* operator new(size_t size) noexcept;
+    static void operator delete(void* p);
+
+    uint32_t packetDataSize() const { return _packetDataSize; }
+    //  The capacity of the segment being written - safe to call from any
+    //  thread.
+    uint32_t capacity() const;
+    //  The number of times the ring was resized.
+    uint32_t resizeCount() const;
+
+    //  Closes the buffer, releasing any waiting Producer or Consumer.
+    //  Packets already written may still be read.
+    void close();
+    bool closed() const;
+
+    //  Consumer methods
+    //  Only stable when called by the Consumer.
+    bool empty();
+    //  Waits until a packet is readable.  Returns false if the buffer was
+    //  closed and has no packets left to read.
+    bool waitForRead();
+    ConstPacketSpan peekRead(uint32_t maxCount);
+    void releaseRead(uint32_t count);
+
+    //  Producer methods
+    //  Waits until a packet is writable, resizing first if the segment is
+    //  full and the policy says so.  Returns false if the buffer was closed.
+    bool waitForWrite();
+    //  As PacketBuffer::reserveWrite.  Every packet reserved must be
+    //  committed (or abandoned) before the next reservation, as the
+    //  reservation may move the Producer to a new segment.
+    PacketSpan reserveWrite(uint32_t maxCount);
+    void commitWrite(uint32_t count);
+
+private:
+    struct Segment
+    {
+        Segment(uint32_t packetDataSize, uint32_t packetCapacity);
+
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* p);
+
+        RingIndex index;
+        RingStorage storage;
+        std::vector<Packet> packets;
+        //  Set by the Producer once it has moved on to the next segment -
+        //  the Producer never touches this segment again.
+        std::atomic<Segment*> next;
+    };
+
+    void applyPolicy();
+    void resizeTo(uint32_t capacity);
+    Segment* readSegment();
+    bool writeFull();
+
+    const uint32_t _packetDataSize;
+    ResizePolicy* _resizePolicy;
+
+    //  Producer owned
+    alignas(kCacheLineSize) Segment* _writeSegment;
+    std::atomic<uint32_t> _capacity;
+    std::atomic<uint32_t> _resizeCount;
+    uint64_t _writeSequence;
+    //  set once the policy has been told of the current stall
+    bool _writeStalled;
+    uint32_t _idleReservations;
+    //  Consumer owned
+    alignas(kCacheLineSize) Segment* _readSegment;
+    uint64_t _readSequence;
+
+    alignas(kCacheLineSize) WaitStrategy _readWait;
+    alignas(kCacheLineSize) WaitStrategy _writeWait;
+    std::atomic<bool> _closed;
+};
+
+inline uint32_t SegmentedPacketBuffer::capacity() const
+{
+    return _capacity.load(std::memory_order_relaxed);
+}
+
+inline uint32_t SegmentedPacketBuffer::resizeCount() const
+{
+    return _resizeCount.load(std::memory_order_relaxed);
+}
+
+inline bool SegmentedPacketBuffer::closed() const
+{
+    return _closed.load(std::memory_order_acquire);
+}
+
+
+#endif
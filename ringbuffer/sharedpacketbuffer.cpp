@@ -0,0 +1,360 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "sharedpacketbuffer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//  Identifies an initialized segment - written last by the creator.
+static const uint32_t kSharedRingMagic = 0x534b5242;      // 'SKRB'
+static const uint32_t kSharedRingVersion = 2;
+
+//  The start of the segment.  Only lock-free atomics and the WaitStrategies
+//  (constructed as process shared) are placed here.
+//
+struct SharedPacketBuffer::Header
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t packetDataSize;
+    uint32_t packetCapacity;
+    uint64_t segmentSize;
+    int32_t creatorPid;
+    std::atomic<int32_t> attachedPid;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> writeSequence;
+    alignas(kCacheLineSize) std::atomic<uint64_t> readSequence;
+    alignas(kCacheLineSize) WaitStrategy readWait;
+    alignas(kCacheLineSize) WaitStrategy writeWait;
+    std::atomic<uint32_t> closed;
+
+    Header(WaitStrategy::Policy waitPolicy) :
+        magic(0),
+        version(kSharedRingVersion),
+        packetDataSize(0),
+        packetCapacity(0),
+        segmentSize(0),
+        creatorPid((int32_t)getpid()),
+        attachedPid(0),
+        writeSequence(0),
+        readSequence(0),
+        readWait(waitPolicy, true),
+        writeWait(waitPolicy, true),
+        closed(0)
+    {
+    }
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "shared ring sequences must be lock-free atomics");
+
+size_t SharedPacketBuffer::descriptorsOffset()
+{
+    return (sizeof(Header) + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+}
+
+size_t SharedPacketBuffer::dataOffset(uint32_t packetCapacity)
+{
+    size_t pageSize = RingStorage::pageSize();
+    size_t end = descriptorsOffset() + sizeof(SharedPacket) * packetCapacity;
+    return (end + pageSize - 1) & ~(pageSize - 1);
+}
+
+SharedPacketBuffer* SharedPacketBuffer::create(const char* name,
+                                               uint32_t packetDataSize,
+                                               uint32_t packetCapacity,
+                                               WaitStrategy::Policy waitPolicy)
+{
+    if (!packetCapacity)
+        return nullptr;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return nullptr;
+
+    size_t segmentSize = dataOffset(packetCapacity) +
+                         (size_t)packetDataSize * packetCapacity;
+    void* segment = MAP_FAILED;
+    if (ftruncate(fd, (off_t)segmentSize) == 0)
+    {
+        segment = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+    }
+    ::close(fd);
+    if (segment == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return nullptr;
+    }
+
+    uint8_t* base = reinterpret_cast<uint8_t*>(segment);
+    Header* header = new(base) Header(waitPolicy);
+    header->packetDataSize = packetDataSize;
+    header->packetCapacity = packetCapacity;
+    header->segmentSize = segmentSize;
+
+    SharedPacket* packets = reinterpret_cast<SharedPacket*>(base + descriptorsOffset());
+    uint64_t offset = dataOffset(packetCapacity);
+    for (uint32_t i = 0; i < packetCapacity; ++i)
+    {
+        packets[i].offset = offset;
+        packets[i].size = 0;
+        packets[i].reserved = 0;
+        offset += packetDataSize;
+    }
+    //  publishes the initialized segment to attaching processes.
+    header->magic.store(kSharedRingMagic, std::memory_order_release);
+
+    return new SharedPacketBuffer(name, base, segmentSize, true);
+}
+
+SharedPacketBuffer* SharedPacketBuffer::attach(const char* name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat info;
+    void* segment = MAP_FAILED;
+    size_t segmentSize = 0;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= descriptorsOffset())
+    {
+        segmentSize = (size_t)info.st_size;
+        segment = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+    }
+    ::close(fd);
+    if (segment == MAP_FAILED)
+        return nullptr;
+
+    uint8_t* base = reinterpret_cast<uint8_t*>(segment);
+    Header* header = reinterpret_cast<Header*>(base);
+    if (header->magic.load(std::memory_order_acquire) != kSharedRingMagic ||
+        header->version != kSharedRingVersion ||
+        header->segmentSize != segmentSize ||
+        !validGeometry(base, segmentSize))
+    {
+        munmap(segment, segmentSize);
+        return nullptr;
+    }
+    header->attachedPid.store((int32_t)getpid(), std::memory_order_release);
+    return new SharedPacketBuffer(name, base, segmentSize, false);
+}
+
+//  The segment comes from another process, so everything our descriptors are
+//  built from is checked against the segment we actually mapped.
+//
+bool SharedPacketBuffer::validGeometry(const uint8_t* segment, size_t segmentSize)
+{
+    const Header* header = reinterpret_cast<const Header*>(segment);
+    uint32_t packetDataSize = header->packetDataSize;
+    uint32_t packetCapacity = header->packetCapacity;
+    if (!packetCapacity ||
+        dataOffset(packetCapacity) + (uint64_t)packetCapacity * packetDataSize != segmentSize)
+    {
+        return false;
+    }
+    const SharedPacket* packets =
+        reinterpret_cast<const SharedPacket*>(segment + descriptorsOffset());
+    for (uint32_t i = 0; i < packetCapacity; ++i)
+    {
+        if (packets[i].offset < dataOffset(packetCapacity) ||
+            packets[i].offset > segmentSize - packetDataSize ||
+            packets[i].size > packetDataSize)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+SharedPacketBuffer::SharedPacketBuffer(const char* name, uint8_t* segment,
+                                       size_t segmentSize, bool owner) :
+    _name(name),
+    _segment(segment),
+    _segmentSize(segmentSize),
+    _owner(owner),
+    _header(reinterpret_cast<Header*>(segment)),
+    _sharedPackets(reinterpret_cast<SharedPacket*>(segment + descriptorsOffset())),
+    _packetDataSize(_header->packetDataSize),
+    _packetCapacity(_header->packetCapacity),
+    _mask(_packetCapacity > 1 && !(_packetCapacity & (_packetCapacity - 1)) ?
+          _packetCapacity - 1 : 0),
+    _packets(_packetCapacity),
+    _readSequenceCache(_header->readSequence.load(std::memory_order_acquire)),
+    _writeSequenceCache(_header->writeSequence.load(std::memory_order_acquire))
+{
+    for (uint32_t i = 0; i < _packetCapacity; ++i)
+    {
+        _packets[i].data = _segment + _sharedPackets[i].offset;
+        _packets[i].size = _sharedPackets[i].size;
+    }
+}
+
+SharedPacketBuffer::~SharedPacketBuffer()
+{
+    if (_owner)
+    {
+        //  the attached process may still be using the header - it's left
+        //  for the last unmap to free.
+        shm_unlink(_name.c_str());
+    }
+    munmap(_segment, _segmentSize);
+}
+
+bool SharedPacketBuffer::empty() const
+{
+    return _header->readSequence.load(std::memory_order_acquire) ==
+           _header->writeSequence.load(std::memory_order_acquire);
+}
+
+uint32_t SharedPacketBuffer::slot(uint64_t sequence) const
+{
+    return _mask ? (uint32_t)(sequence & _mask)
+                 : (uint32_t)(sequence % _packetCapacity);
+}
+
+bool SharedPacketBuffer::closed() const
+{
+    return _header->closed.load(std::memory_order_acquire) != 0;
+}
+
+bool SharedPacketBuffer::peerAlive() const
+{
+    pid_t pid = _owner ? _header->attachedPid.load(std::memory_order_acquire)
+                       : _header->creatorPid;
+    if (!pid)
+        return false;
+    //  EPERM - the process exists, but belongs to another user
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+bool SharedPacketBuffer::full() const
+{
+    return _header->writeSequence.load(std::memory_order_relaxed) -
+           _header->readSequence.load(std::memory_order_acquire) >= _packetCapacity;
+}
+
+void SharedPacketBuffer::close()
+{
+    _header->closed.store(1, std::memory_order_release);
+    _header->readWait.notify();
+    _header->writeWait.notify();
+}
+
+bool SharedPacketBuffer::waitForRead()
+{
+    _header->readWait.wait([this]() -> bool { return !empty() || closed(); });
+    return !empty();
+}
+
+bool SharedPacketBuffer::waitForWrite()
+{
+    _header->writeWait.wait([this]() -> bool { return !full() || closed(); });
+    return !closed();
+}
+
+bool SharedPacketBuffer::waitForRead(uint32_t timeoutMs)
+{
+    _header->readWait.waitFor([this]() -> bool { return !empty() || closed(); },
+                              timeoutMs);
+    return !empty();
+}
+
+bool SharedPacketBuffer::waitForWrite(uint32_t timeoutMs)
+{
+    return _header->writeWait.waitFor([this]() -> bool { return !full() || closed(); },
+                                      timeoutMs) && !closed();
+}
+
+ConstPacketSpan SharedPacketBuffer::peekRead(uint32_t maxCount)
+{
+    uint64_t readSequence = _header->readSequence.load(std::memory_order_relaxed);
+    ConstPacketSpan span = { nullptr, 0, readSequence };
+    uint64_t available = _writeSequenceCache - readSequence;
+    if (available < maxCount)
+    {
+        _writeSequenceCache = _header->writeSequence.load(std::memory_order_acquire);
+        available = _writeSequenceCache - readSequence;
+    }
+    uint32_t readIndex = slot(readSequence);
+    //  the other process could publish anything, so the span is bounded by
+    //  the packet array whatever its sequences say.
+    span.count = (uint32_t)std::min<uint64_t>(std::min<uint64_t>(available, maxCount),
+                                              _packetCapacity - readIndex);
+    if (span.count)
+    {
+        span.packets = &_packets[readIndex];
+        for (uint32_t i = readIndex; i < readIndex + span.count; ++i)
+            _packets[i].size = std::min(_sharedPackets[i].size, _packetDataSize);
+    }
+    return span;
+}
+
+void SharedPacketBuffer::releaseRead(uint32_t count)
+{
+    uint64_t readSequence = _header->readSequence.load(std::memory_order_relaxed);
+    _header->readSequence.store(readSequence + count, std::memory_order_release);
+    _header->writeWait.notify();
+}
+
+PacketSpan SharedPacketBuffer::reserveWrite(uint32_t maxCount)
+{
+    uint64_t writeSequence = _header->writeSequence.load(std::memory_order_relaxed);
+    PacketSpan span = { nullptr, 0, writeSequence };
+    uint64_t used = writeSequence - _readSequenceCache;
+    if (_packetCapacity - std::min<uint64_t>(used, _packetCapacity) < maxCount)
+    {
+        _readSequenceCache = _header->readSequence.load(std::memory_order_acquire);
+        used = writeSequence - _readSequenceCache;
+    }
+    uint32_t available = _packetCapacity - (uint32_t)std::min<uint64_t>(used, _packetCapacity);
+    uint32_t writeIndex = slot(writeSequence);
+    span.count = std::min(std::min(available, maxCount), _packetCapacity - writeIndex);
+    if (span.count)
+    {
+        span.packets = &_packets[writeIndex];
+        for (uint32_t i = 0; i < span.count; ++i)
+            span.packets[i].size = _packetDataSize;
+    }
+    return span;
+}
+
+void SharedPacketBuffer::commitWrite(uint32_t count)
+{
+    uint64_t writeSequence = _header->writeSequence.load(std::memory_order_relaxed);
+    uint32_t writeIndex = slot(writeSequence);
+    for (uint32_t i = writeIndex; i < writeIndex + count; ++i)
+        _sharedPackets[i].size = _packets[i].size;
+    _header->writeSequence.store(writeSequence + count, std::memory_order_release);
+    _header->readWait.notify();
+}
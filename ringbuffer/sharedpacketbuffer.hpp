@@ -0,0 +1,146 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_SharedPacketBuffer_hpp
+#define CK_Sample_SharedPacketBuffer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//  A PacketBuffer shared between two processes through a named POSIX shared
+//  memory segment.
+//
+//  The segment holds a header (the ring's geometry, indices and wait state),
+//  the packet descriptors and the packet data.  Descriptors in the segment
+//  store offsets rather than pointers, since each process maps the segment
+//  at its own address.  Each process keeps a local Packet array pointing at
+//  its own mapping - as with mirrored PacketBuffer descriptors, commitWrite
+//  copies packet sizes into the shared descriptors and peekRead copies them
+//  back out.
+//
+//  Positions are 64-bit sequences as in a RingIndex, so all packetCapacity
+//  packets are usable and spans carry the sequence of their first packet.
+//
+//  One process creates the ring, and the other attaches to it by name.
+//  Either may be the Producer (or Consumer) - each process must only use one
+//  side.  Waiting uses process shared futexes (or process shared condition
+//  variables on non-Linux platforms.)  The creator unlinks the name when its
+//  buffer is destroyed, and the memory is released once both processes have
+//  unmapped it.
+//
+class SharedPacketBuffer
+{
+public:
+    //  Creates a new shared ring.  Returns nullptr if a segment with the
+    //  name already exists or the segment couldn't be created.
+    static SharedPacketBuffer* create(const char* name,
+                                      uint32_t packetDataSize,
+                                      uint32_t packetCapacity,
+                                      WaitStrategy::Policy waitPolicy=WaitStrategy::kBlocking);
+    //  Attaches to a ring created by another process.  Returns nullptr if
+    //  there's no such ring, it isn't initialized yet, or its geometry and
+    //  descriptors don't fit the segment.
+    static SharedPacketBuffer* attach(const char* name);
+
+    ~SharedPacketBuffer();
+
+    SharedPacketBuffer(const SharedPacketBuffer&) = delete;
+    SharedPacketBuffer& operator=(const SharedPacketBuffer&) = delete;
+
+    uint32_t packetDataSize() const { return _packetDataSize; }
+    uint32_t capacity() const { return _packetCapacity; }
+
+    bool empty() const;
+
+    //  Closes the buffer, releasing the waiting side in either process.
+    void close();
+    bool closed() const;
+
+    //  Whether the other process is still running - for the creator, the
+    //  process that attached (false until one has.)  A peer that exits
+    //  without closing the ring would otherwise leave this side waiting
+    //  forever, so long waits should use the timed methods below and check
+    //  this when they time out.
+    bool peerAlive() const;
+
+    //  Consumer methods - as PacketBuffer.
+    bool waitForRead();
+    //  Returns false if the ring is drained and closed, or if timeoutMs
+    //  passes first (the ring isn't closed.)
+    bool waitForRead(uint32_t timeoutMs);
+    ConstPacketSpan peekRead(uint32_t maxCount);
+    void releaseRead(uint32_t count);
+
+    //  Producer methods - as PacketBuffer.
+    bool waitForWrite();
+    //  Returns false if the ring is closed, or if timeoutMs passes first
+    //  (the ring isn't closed.)
+    bool waitForWrite(uint32_t timeoutMs);
+    PacketSpan reserveWrite(uint32_t maxCount);
+    void commitWrite(uint32_t count);
+
+private:
+    struct Header;
+    struct SharedPacket
+    {
+        uint64_t offset;        // from the start of the segment
+        uint32_t size;
+        uint32_t reserved;
+    };
+
+    SharedPacketBuffer(const char* name, uint8_t* segment, size_t segmentSize,
+                       bool owner);
+
+    static size_t descriptorsOffset();
+    static size_t dataOffset(uint32_t packetCapacity);
+    static bool validGeometry(const uint8_t* segment, size_t segmentSize);
+    bool full() const;
+    uint32_t slot(uint64_t sequence) const;
+
+    std::string _name;
+    uint8_t* _segment;
+    size_t _segmentSize;
+    bool _owner;
+
+    Header* _header;
+    SharedPacket* _sharedPackets;
+    uint32_t _packetDataSize;
+    uint32_t _packetCapacity;
+    //  capacity - 1 for power of two capacities, zero otherwise.
+    uint32_t _mask;
+    //  this process's view of the descriptors
+    std::vector<Packet> _packets;
+
+    //  local caches of the other side's sequence
+    uint64_t _readSequenceCache;
+    uint64_t _writeSequenceCache;
+};
+
+
+#endif
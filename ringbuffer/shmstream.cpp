@@ -0,0 +1,219 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "sharedpacketbuffer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+//  Streams a file from one process to another through a SharedPacketBuffer.
+//
+//  The sender creates the named ring and fills it from its file.  The
+//  receiver attaches to the ring by name and writes what it reads to its
+//  file.  Start the sender first - the receiver retries for a few seconds
+//  while the ring doesn't exist yet, and the sender gives up if no receiver
+//  attaches within a few seconds.  Either side stops with an error if the
+//  other exits without closing the ring.
+//
+
+//  how long a side waits on the ring between checks that its peer is alive
+static const uint32_t kLivenessCheckMs = 100;
+
+static int send(const char* name, int fd)
+{
+    SharedPacketBuffer* buffer = SharedPacketBuffer::create(name, 64*1024, 16);
+    if (!buffer)
+    {
+        std::cout << "failed to create shared ring '" << name << "'" << std::endl;
+        return 1;
+    }
+
+    int result = 0;
+    for (int attempt = 0; attempt < 1000 && !buffer->peerAlive(); ++attempt)
+    {
+        usleep(10000);
+    }
+    if (!buffer->peerAlive())
+    {
+        std::cout << "no receiver attached to shared ring '" << name << "'" << std::endl;
+        result = 3;
+    }
+
+    while (!result)
+    {
+        if (!buffer->waitForWrite(kLivenessCheckMs))
+        {
+            //  the receiver only closes the ring on us when it fails
+            if (buffer->closed())
+            {
+                std::cout << "receiver stopped" << std::endl;
+                result = 3;
+            }
+            else if (!buffer->peerAlive())
+            {
+                std::cout << "receiver exited" << std::endl;
+                result = 3;
+            }
+            continue;
+        }
+        PacketSpan writeTo = buffer->reserveWrite(UINT32_MAX);
+        ssize_t sz = read(fd, writeTo.packets[0].data,
+                          (size_t)writeTo.count * buffer->packetDataSize());
+        if (sz < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            result = 2;
+            break;
+        }
+        if (!sz)
+            break;
+
+        uint32_t packetCount = 0;
+        while (sz > 0)
+        {
+            Packet& packet = writeTo.packets[packetCount++];
+            if (sz < packet.size)
+                packet.size = (uint32_t)sz;
+            sz -= packet.size;
+        }
+        buffer->commitWrite(packetCount);
+    }
+    buffer->close();
+
+    //  the receiver can't attach once we unlink the ring, so wait for it to
+    //  drain what we've written.
+    while (!result && !buffer->empty())
+    {
+        if (!buffer->peerAlive())
+        {
+            std::cout << "receiver exited" << std::endl;
+            result = 3;
+            break;
+        }
+        usleep(1000);
+    }
+    delete buffer;
+    return result;
+}
+
+static int receive(const char* name, int fd)
+{
+    SharedPacketBuffer* buffer = nullptr;
+    for (int attempt = 0; attempt < 500 && !buffer; ++attempt)
+    {
+        buffer = SharedPacketBuffer::attach(name);
+        if (!buffer)
+            usleep(10000);
+    }
+    if (!buffer)
+    {
+        std::cout << "failed to attach to shared ring '" << name << "'" << std::endl;
+        return 1;
+    }
+
+    int result = 0;
+    size_t outputCount = 0;
+    while (!result)
+    {
+        if (!buffer->waitForRead(kLivenessCheckMs))
+        {
+            //  the ring is drained and the sender is done
+            if (buffer->closed())
+                break;
+            if (!buffer->peerAlive())
+            {
+                std::cout << "sender exited" << std::endl;
+                result = 3;
+            }
+            continue;
+        }
+        ConstPacketSpan readFrom = buffer->peekRead(UINT32_MAX);
+        for (uint32_t i = 0; i < readFrom.count && !result; ++i)
+        {
+            const Packet& packet = readFrom.packets[i];
+            uint32_t written = 0;
+            while (written < packet.size)
+            {
+                ssize_t sz = write(fd, packet.data + written, packet.size - written);
+                if (sz < 0 && errno == EINTR)
+                    continue;
+                if (sz <= 0)
+                {
+                    result = 2;
+                    break;
+                }
+                written += (uint32_t)sz;
+            }
+            outputCount += written;
+        }
+        buffer->releaseRead(readFrom.count);
+    }
+    if (result)
+    {
+        //  stop the sender, and discard what's left so it isn't left waiting
+        //  for us to drain the ring.
+        buffer->close();
+        ConstPacketSpan readFrom;
+        while ((readFrom = buffer->peekRead(UINT32_MAX)).count)
+            buffer->releaseRead(readFrom.count);
+    }
+
+    std::cout << "received " << outputCount << " bytes" << std::endl;
+    delete buffer;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, const char* argv[])
+{
+    bool sending = argc == 4 && !strcmp(argv[1], "send");
+    bool receiving = argc == 4 && !strcmp(argv[1], "recv");
+    if (!sending && !receiving)
+    {
+        std::cout << "shmstream send <ring name> <in filename>" << std::endl;
+        std::cout << "shmstream recv <ring name> <out filename>" << std::endl;
+        std::cout << "  ring names are POSIX shared memory names, i.e. /telemetry" << std::endl;
+        return 1;
+    }
+
+    const char* fileName = argv[3];
+    int fd = sending ? open(fileName, O_RDONLY)
+                     : open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        std::cout << "file '" << fileName << "' failed to open" << std::endl;
+        return 1;
+    }
+
+    int result = sending ? send(argv[2], fd) : receive(argv[2], fd);
+    close(fd);
+    return result;
+}
@@ -0,0 +1,215 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "streambufio.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <time.h>
+#include <unistd.h>
+
+//  Populates the buffer's write section from the input stream.  If the write
+//  buffer fills up, waits (using the buffer's wait policy) for the reader to
+//  process data before reading more from the stream.
+//
+int StreambufInput::produce(PacketBuffer& buffer)
+{
+    //  returns false if the reader closed the buffer on us
+    while (buffer.waitForWrite())
+    {
+        //  the reserved packets are contiguous in memory (including across
+        //  the end of the ring when our buffer is mirrored), so fill them
+        //  with a single read - unless the buffer pads its packets.
+        uint32_t maxCount = buffer.packetStride() == buffer.packetDataSize() ?
+            UINT32_MAX : 1;
+        PacketSpan writeTo = buffer.reserveWrite(maxCount);
+
+        std::streamsize sz = _infile.sgetn((char*)writeTo.packets[0].data,
+                        (std::streamsize)writeTo.count * buffer.packetDataSize());
+        if (!sz)
+            break;
+
+        uint32_t packetCount = 0;
+        while (sz > 0)
+        {
+            Packet& packet = writeTo.packets[packetCount++];
+            if (sz < packet.size)
+                packet.size = (uint32_t)sz;
+            sz -= packet.size;
+        }
+        buffer.commitWrite(packetCount);
+    }
+    return 0;
+}
+
+//  Acquires data from the buffer's read section and outputs it to the
+//  stream.  When the buffer is empty, waits on the buffer using its wait
+//  policy.
+//
+int StreambufOutput::consume(PacketBuffer& buffer)
+{
+    //  returns false once the buffer is flushed and input is done
+    while (buffer.waitForRead())
+    {
+        //  drain everything readable in one pass, releasing each packet as
+        //  it's output so the writer can refill it.
+        ConstPacketSpan readSpan = buffer.peekRead(UINT32_MAX);
+        for (uint32_t i = 0; i < readSpan.count; ++i)
+        {       
+            const Packet* readFrom = &readSpan.packets[i];
+            std::streamsize sz = 0;
+            uint32_t readFromAmt = 0;
+            while (readFromAmt < readFrom->size)
+            {
+                //  emulating an output of 16 bytes per cycle
+                uint32_t chunk = std::min(readFrom->size - readFromAmt, 16u);
+                sz = _outfile.sputn((char*)readFrom->data+readFromAmt, chunk);
+                if (!sz)
+                    break;
+                usleep(20);
+                readFromAmt += sz;
+            }
+            addOutputCount(readFromAmt);
+            if (!sz)
+                return 2;
+            buffer.releaseRead(1);
+        }
+    }
+    return 0;
+}
+
+static uint64_t monotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static void sleepUntilNs(uint64_t deadlineNs)
+{
+    timespec deadline;
+    deadline.tv_sec = (time_t)(deadlineNs / 1000000000ULL);
+    deadline.tv_nsec = (long)(deadlineNs % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        ;
+}
+
+PacedOutput::PacedOutput(std::streambuf& out, uint32_t bytesPerPeriod,
+                         uint64_t periodNs) :
+    _outfile(out),
+    _bytesPerPeriod(bytesPerPeriod),
+    _periodNs(periodNs),
+    _stats(),
+    _jitterTotalNs(0),
+    _fillTotal(0)
+{
+}
+
+//  Starts the clock once the first packet arrives, as a device would start
+//  once primed, then pulls a period's bytes at every deadline until the
+//  buffer is closed and drained.
+//
+int PacedOutput::consume(PacketBuffer& buffer)
+{
+    if (!buffer.waitForRead())
+        return 0;
+
+    uint64_t deadlineNs = monotonicNs();
+    uint32_t packetOffset = 0;
+    for (;;)
+    {
+        deadlineNs += _periodNs;
+        sleepUntilNs(deadlineNs);
+
+        uint64_t latenessNs = monotonicNs() - deadlineNs;
+        if (latenessNs >= _periodNs)
+        {
+            //  resume on the next deadline instead of bursting through the
+            //  missed ones.
+            ++_stats.overruns;
+            deadlineNs += (latenessNs / _periodNs) * _periodNs;
+        }
+        uint32_t fill = (uint32_t)(buffer.writeSequence() - buffer.readSequence());
+        recordPeriod(latenessNs, fill, buffer.capacity());
+
+        uint32_t needed = _bytesPerPeriod;
+        while (needed)
+        {
+            ConstPacketSpan readSpan = buffer.peekRead(1);
+            if (!readSpan.count)
+                break;
+            const Packet& readFrom = readSpan.packets[0];
+            uint32_t chunk = std::min(readFrom.size - packetOffset, needed);
+            if (chunk && _outfile.sputn((char*)readFrom.data + packetOffset, chunk) != chunk)
+                return 2;
+            addOutputCount(chunk);
+            packetOffset += chunk;
+            needed -= chunk;
+            if (packetOffset == readFrom.size)
+            {
+                buffer.releaseRead(1);
+                packetOffset = 0;
+            }
+        }
+        if (needed)
+        {
+            //  the Producer closes the buffer after its last commit, so a
+            //  closed and empty buffer is the end of the stream.
+            if (buffer.closed() && buffer.empty())
+                break;
+            ++_stats.underruns;
+        }
+    }
+    return 0;
+}
+
+void PacedOutput::recordPeriod(uint64_t latenessNs, uint32_t fill, uint32_t capacity)
+{
+    if (!_stats.periods)
+    {
+        _stats.jitterMinNs = _stats.jitterMaxNs = latenessNs;
+        _stats.fillMin = _stats.fillMax = fill;
+    }
+    ++_stats.periods;
+    _stats.jitterMinNs = std::min(_stats.jitterMinNs, latenessNs);
+    _stats.jitterMaxNs = std::max(_stats.jitterMaxNs, latenessNs);
+    _jitterTotalNs += latenessNs;
+    _stats.fillMin = std::min(_stats.fillMin, fill);
+    _stats.fillMax = std::max(_stats.fillMax, fill);
+    _fillTotal += fill;
+    if (fill == capacity)
+        ++_stats.fullPeriods;
+}
+
+auto PacedOutput::stats() const -> Stats
+{
+    Stats stats = _stats;
+    if (stats.periods)
+    {
+        stats.jitterMeanNs = _jitterTotalNs / stats.periods;
+        stats.fillMean = (double)_fillTotal / stats.periods;
+    }
+    return stats;
+}
@@ -0,0 +1,122 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_StreambufIO_hpp
+#define CK_Sample_StreambufIO_hpp
+
+#include "streamer.hpp"
+
+#include <streambuf>
+
+//  Reads the input stream straight into the buffer's reserved packets.
+//
+class StreambufInput : public StreamInput
+{
+public:
+    StreambufInput(std::streambuf& in) : _infile(in) {}
+
+    int produce(PacketBuffer& buffer) override;
+
+private:
+    std::streambuf& _infile;
+};
+
+//  Writes packets to the output stream.
+//
+//  Note - this output uses usleeps to simulate a "slower" serialized
+//  output device that runs at approximately 48khz (i.e. a sound mixer.)
+//  This delay would normally allow our writer and main threads to run
+//  while the reader processes data.
+//
+class StreambufOutput : public StreamOutput
+{
+public:
+    StreambufOutput(std::streambuf& out) : _outfile(out) {}
+
+    int consume(PacketBuffer& buffer) override;
+
+private:
+    std::streambuf& _outfile;
+};
+
+//  Writes packets to the output stream at a fixed rate, as a real-time device
+//  (an audio mixer, say) would pull them.
+//
+//  Every period, on an absolute deadline clock, the output pulls
+//  bytesPerPeriod bytes from the buffer.  Deadlines are fixed multiples of
+//  the period from the first packet, so the output doesn't drift however
+//  long each period's work takes.
+//
+//  Each period records:
+//      underrun - fewer than bytesPerPeriod bytes were readable.  The bytes
+//                 that were readable are output, so the stream is complete
+//                 but would have glitched on a real device.
+//      overrun  - the output woke a full period or more past its deadline,
+//                 missing deadlines.  The missed periods are skipped rather
+//                 than caught up with a burst.
+//      jitter   - how late the output woke for the deadline.
+//      fill     - the packets readable at the deadline.
+//
+//  Together these show whether the ring's capacity covers the Producer's
+//  stalls (underruns with a low fill) and how much slack it has.
+//
+class PacedOutput : public StreamOutput
+{
+public:
+    struct Stats
+    {
+        uint64_t periods;
+        uint64_t underruns;
+        uint64_t overruns;
+        uint64_t jitterMinNs;
+        uint64_t jitterMaxNs;
+        uint64_t jitterMeanNs;
+        uint32_t fillMin;
+        uint32_t fillMax;
+        double fillMean;
+        //  periods starting with every packet of the buffer readable.
+        uint64_t fullPeriods;
+    };
+
+    PacedOutput(std::streambuf& out, uint32_t bytesPerPeriod, uint64_t periodNs);
+
+    int consume(PacketBuffer& buffer) override;
+
+    //  Only stable once the stream is done.
+    Stats stats() const;
+
+private:
+    void recordPeriod(uint64_t latenessNs, uint32_t fill, uint32_t capacity);
+
+    std::streambuf& _outfile;
+    const uint32_t _bytesPerPeriod;
+    const uint64_t _periodNs;
+
+    Stats _stats;
+    uint64_t _jitterTotalNs;
+    uint64_t _fillTotal;
+};
+
+
+#endif
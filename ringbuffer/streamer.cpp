@@ -0,0 +1,117 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "streamer.hpp"
+
+#include <iostream>
+
+#include <sched.h>
+
+//  The reader prefaults the buffer in place of its constructor.
+static RingAllocation withoutPrefault(RingAllocation allocation)
+{
+    allocation.flags &= ~RingAllocation::kPrefault;
+    return allocation;
+}
+
+void* Streamer::writer_thread(void* arg)
+{
+    Streamer* stream = reinterpret_cast<Streamer*>(arg);
+    while (!stream->_bufferReady.load(std::memory_order_acquire))
+        sched_yield();
+
+    intptr_t result = stream->_input.produce(stream->_buffer);
+
+    stream->_inputActive = false;
+    stream->_buffer.close();
+
+    std::cout << "writer terminated : " << result << std::endl << std::flush;
+
+    return (void*)result;
+}
+
+void* Streamer::reader_thread(void* arg)
+{
+    Streamer* stream = reinterpret_cast<Streamer*>(arg);
+    if (!stream->_bufferReady.load(std::memory_order_relaxed))
+    {
+        stream->_buffer.storage().prefault();
+        stream->_bufferReady.store(true, std::memory_order_release);
+    }
+
+    intptr_t result = stream->_output.consume(stream->_buffer);
+
+    stream->_outputActive = false;
+    stream->_buffer.close();
+
+    std::cout << "reader terminated : " << result << std::endl << std::flush;
+
+    return (void* )result;
+}
+
+
+Streamer::Streamer(StreamInput& in, StreamOutput& out,
+                   uint32_t packetDataSize, uint32_t bufferCapacity,
+                   RingStorage::Type storageType,
+                   WaitStrategy::Policy waitPolicy,
+                   const RingAllocation& allocation,
+                   bool checksums) :
+    _input(in),
+    _output(out),
+    _inputActive(true),
+    _outputActive(true),
+    _bufferReady(!(allocation.flags & RingAllocation::kPrefault)),
+    _buffer(packetDataSize, bufferCapacity, storageType, waitPolicy,
+            withoutPrefault(allocation)),
+    _writerThread(0),
+    _readerThread(0)
+{
+    _buffer.enableStats();
+    if (checksums)
+        _buffer.enableChecksums();
+
+    //  spin up our reader and writer threads
+    int res = pthread_create(&_writerThread, NULL, Streamer::writer_thread, this);
+    if (res)
+    {
+        std::cout << "pthread_create(writer) failed: " << res << std::endl;
+        return;
+    }
+
+    res = pthread_create(&_readerThread, NULL, Streamer::reader_thread, this);
+    if (res)
+    {
+        std::cout << "pthread_create(reader) failed: " << res << std::endl;
+        //  release the writer, which is left to fill the buffer and stop.
+        _bufferReady.store(true, std::memory_order_release);
+        return;
+    }
+}
+
+Streamer::~Streamer()
+{
+    _buffer.close();
+    pthread_join(_writerThread, NULL);
+    pthread_join(_readerThread, NULL);
+}
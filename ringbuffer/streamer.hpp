@@ -0,0 +1,152 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_Streamer_hpp
+#define CK_Sample_Streamer_hpp
+
+#include "packetbuffer.hpp"
+
+#include <atomic>
+#include <cstddef>
+
+#include <pthread.h>
+
+//  The Producer side of a Streamer - fills the buffer from some source.
+//
+class StreamInput
+{
+public:
+    virtual ~StreamInput() {}
+
+    //  Writes packets into the buffer until the input is exhausted or the
+    //  buffer is closed.  Returns 0 on success, or a nonzero error code.
+    virtual int produce(PacketBuffer& buffer) = 0;
+};
+
+//  The Consumer side of a Streamer - drains the buffer to some destination.
+//
+class StreamOutput
+{
+public:
+    StreamOutput() : _outputCount(0) {}
+    virtual ~StreamOutput() {}
+
+    //  Reads packets from the buffer until the buffer is closed and empty.
+    //  Returns 0 on success, or a nonzero error code.
+    virtual int consume(PacketBuffer& buffer) = 0;
+
+    //  Bytes output so far - safe to call from any thread.
+    size_t outputCount() const {
+        return _outputCount.load(std::memory_order_relaxed);
+    }
+
+protected:
+    void addOutputCount(size_t count) {
+        _outputCount.fetch_add(count, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> _outputCount;
+};
+
+//
+//  The Stream manages sync between a Reader and Writer threads, and their
+//  common RingBuffer.
+//
+//  The writer thread runs the StreamInput and the reader thread runs the
+//  StreamOutput.  Each closes the buffer when it's done, so that the writer
+//  stops once the reader fails and the reader stops once it has drained the
+//  buffer after the writer finishes.
+//
+//  With RingAllocation::kPrefault, the buffer is prefaulted by the reader
+//  thread before the writer starts, so that pages left to first touch
+//  placement land on the reader's NUMA node.
+//
+//  With checksums, every packet is checksummed by the buffer as the writer
+//  commits it and verified as the reader first reads it.
+//
+//  The buffer always keeps stats, so that stats() shows which side is
+//  holding the stream back while it runs.
+//
+class Streamer
+{
+public:
+    Streamer(StreamInput& in, StreamOutput& out,
+             uint32_t packetDataSize, uint32_t bufferCapacity,
+             RingStorage::Type storageType,
+             WaitStrategy::Policy waitPolicy,
+             const RingAllocation& allocation=RingAllocation(),
+             bool checksums=false);
+    ~Streamer();
+    
+    operator bool() const
+    {
+        return true;
+    }
+
+    bool active() const {
+        return inputActive() || outputActive(); 
+    }
+
+    bool inputActive() const {
+        return _inputActive;
+    }
+    bool outputActive() const {
+        return _outputActive;
+    }
+
+    size_t outputCount() const {
+        return _output.outputCount();
+    }
+
+    //  Packets that failed checksum verification - stable once the reader
+    //  is done.
+    uint64_t checksumErrors() const {
+        return _buffer.checksumErrors();
+    }
+
+    //  The writer (producer) and reader (consumer) sides' stats so far.
+    PacketBuffer::Stats stats() const {
+        return _buffer.stats();
+    }
+
+private:
+    static void* writer_thread(void* arg);
+    static void* reader_thread(void* arg);
+
+private:
+    StreamInput& _input;
+    StreamOutput& _output;
+
+    volatile bool _inputActive;
+    volatile bool _outputActive;
+    std::atomic<bool> _bufferReady;
+
+    PacketBuffer _buffer;
+    pthread_t _writerThread;
+    pthread_t _readerThread;
+};
+
+
+#endif
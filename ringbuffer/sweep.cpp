@@ -0,0 +1,460 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "packetbuffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+//
+//  Sweeps PacketBuffer throughput and latency over packet size, capacity,
+//  wait policy and thread placement.
+//
+//  Every packet carries its sequence number and the time it was committed.
+//  The Consumer records the time from commit to peek in a latency histogram
+//  and checks the sequence, giving packets/sec, bytes/sec and end to end
+//  latency percentiles for each configuration.  Both sides move batches with
+//  reserve/commit and peek/release and wait using the buffer's policy.
+//
+//  Placement is either "same" (both threads pinned to the first CPU) or
+//  "cross" (the threads pinned to different CPUs.)  Busy-spin on a shared
+//  core only measures the scheduler's timeslice, so that pairing is skipped.
+//
+//  Results are printed as a table, and written as JSON with -j.
+//
+
+//  Log-linear histogram of nanosecond latencies - each power of two range is
+//  split into kSubBuckets linear buckets, so percentiles are accurate to
+//  within 1/kSubBuckets of the value.
+//
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : _buckets(kBucketCount, 0), _count(0), _max(0) {}
+
+    void record(uint64_t value)
+    {
+        ++_buckets[bucketIndex(value)];
+        ++_count;
+        _max = std::max(_max, value);
+    }
+
+    uint64_t count() const { return _count; }
+    uint64_t max() const { return _max; }
+
+    //  Returns the upper bound of the bucket holding the given percentile.
+    uint64_t percentile(double p) const
+    {
+        if (!_count)
+            return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * (double)_count);
+        if (rank >= _count)
+            rank = _count - 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < kBucketCount; ++i)
+        {
+            seen += _buckets[i];
+            if (seen > rank)
+                return std::min(bucketLimit(i), _max);
+        }
+        return _max;
+    }
+
+private:
+    enum
+    {
+        kSubBucketBits = 4,
+        kSubBuckets = 1 << kSubBucketBits,
+        kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets
+    };
+
+    static uint32_t bucketIndex(uint64_t value)
+    {
+        if (value < kSubBuckets)
+            return (uint32_t)value;
+        uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+        uint32_t sub = (uint32_t)(value >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+        return (msb - kSubBucketBits + 1) * kSubBuckets + sub;
+    }
+
+    static uint64_t bucketLimit(uint32_t index)
+    {
+        if (index < kSubBuckets)
+            return index;
+        uint32_t msb = index / kSubBuckets + kSubBucketBits - 1;
+        uint64_t sub = index % kSubBuckets;
+        uint64_t width = 1ull << (msb - kSubBucketBits);
+        return (1ull << msb) + (sub + 1) * width - 1;
+    }
+
+    std::vector<uint64_t> _buckets;
+    uint64_t _count;
+    uint64_t _max;
+};
+
+enum Placement
+{
+    kPlacementSame,
+    kPlacementCross
+};
+
+struct SweepConfig
+{
+    uint64_t packetCount;
+    uint32_t packetSize;
+    uint32_t capacity;
+    uint32_t batchSize;
+    WaitStrategy::Policy waitPolicy;
+    Placement placement;
+};
+
+struct SweepResult
+{
+    double seconds;
+    uint64_t packetsPerSec;
+    uint64_t bytesPerSec;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+    bool valid;
+};
+
+struct SweepContext
+{
+    const SweepConfig* config;
+    PacketBuffer* buffer;
+    int cpu;
+    LatencyHistogram latency;
+    bool valid;
+};
+
+//  The header written at the start of every packet.
+struct PacketStamp
+{
+    uint64_t sequence;
+    uint64_t timestamp;
+};
+
+static uint64_t nowNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void pinThread(int cpu)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+static void* sweep_producer(void* arg)
+{
+    SweepContext* context = reinterpret_cast<SweepContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+    const SweepConfig& config = *context->config;
+    pinThread(context->cpu);
+
+    std::vector<uint8_t> payload(config.packetSize, 0x5a);
+
+    for (uint64_t i = 0; i < config.packetCount; )
+    {
+        buffer.waitForWrite();
+        uint64_t remaining = config.packetCount - i;
+        uint32_t batchSize = (uint32_t)std::min<uint64_t>(remaining, config.batchSize);
+        PacketSpan span = buffer.reserveWrite(batchSize);
+        for (uint32_t p = 0; p < span.count; ++p)
+        {
+            memcpy(span.packets[p].data, payload.data(), config.packetSize);
+        }
+        uint64_t timestamp = nowNs();
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+        {
+            PacketStamp stamp = { i, timestamp };
+            memcpy(span.packets[p].data, &stamp, sizeof(stamp));
+        }
+        buffer.commitWrite(span.count);
+    }
+    return nullptr;
+}
+
+static void* sweep_consumer(void* arg)
+{
+    SweepContext* context = reinterpret_cast<SweepContext*>(arg);
+    PacketBuffer& buffer = *context->buffer;
+    const SweepConfig& config = *context->config;
+    pinThread(context->cpu);
+
+    std::vector<uint8_t> sink(config.packetSize);
+
+    for (uint64_t i = 0; i < config.packetCount; )
+    {
+        buffer.waitForRead();
+        ConstPacketSpan span = buffer.peekRead(UINT32_MAX);
+        uint64_t timestamp = nowNs();
+        for (uint32_t p = 0; p < span.count; ++p, ++i)
+        {
+            memcpy(sink.data(), span.packets[p].data, config.packetSize);
+            PacketStamp stamp;
+            memcpy(&stamp, sink.data(), sizeof(stamp));
+            if (stamp.sequence != i)
+                context->valid = false;
+            context->latency.record(timestamp - stamp.timestamp);
+        }
+        buffer.releaseRead(span.count);
+    }
+    return nullptr;
+}
+
+static SweepResult runSweep(const SweepConfig& config, int cpuCount)
+{
+    PacketBuffer buffer(config.packetSize, config.capacity,
+                        RingStorage::kHeap, config.waitPolicy);
+    SweepContext producer;
+    producer.config = &config;
+    producer.buffer = &buffer;
+    producer.cpu = 0;
+    producer.valid = true;
+    SweepContext consumer;
+    consumer.config = &config;
+    consumer.buffer = &buffer;
+    consumer.cpu = config.placement == kPlacementCross ? 1 % cpuCount : 0;
+    consumer.valid = true;
+
+    auto start = std::chrono::steady_clock::now();
+
+    pthread_t producerThread, consumerThread;
+    pthread_create(&consumerThread, NULL, sweep_consumer, &consumer);
+    pthread_create(&producerThread, NULL, sweep_producer, &producer);
+    pthread_join(producerThread, NULL);
+    pthread_join(consumerThread, NULL);
+
+    auto end = std::chrono::steady_clock::now();
+
+    SweepResult result;
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.packetsPerSec = (uint64_t)(config.packetCount / result.seconds);
+    result.bytesPerSec = (uint64_t)(config.packetCount * config.packetSize / result.seconds);
+    result.p50 = consumer.latency.percentile(50.0);
+    result.p99 = consumer.latency.percentile(99.0);
+    result.p999 = consumer.latency.percentile(99.9);
+    result.max = consumer.latency.max();
+    result.valid = consumer.valid && consumer.latency.count() == config.packetCount;
+    return result;
+}
+
+static const char* placementName(Placement placement)
+{
+    return placement == kPlacementCross ? "cross" : "same";
+}
+
+//  Parses a comma separated list of unsigned values.
+static bool parseValues(const char* list, std::vector<uint32_t>* values)
+{
+    values->clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        char* end;
+        unsigned long value = strtoul(item.c_str(), &end, 10);
+        if (*end || !value)
+            return false;
+        values->push_back((uint32_t)value);
+    }
+    return !values->empty();
+}
+
+static bool parsePolicies(const char* list, std::vector<WaitStrategy::Policy>* policies)
+{
+    policies->clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        WaitStrategy::Policy policy;
+        if (!WaitStrategy::parsePolicy(item.c_str(), &policy))
+            return false;
+        policies->push_back(policy);
+    }
+    return !policies->empty();
+}
+
+static bool parsePlacements(const char* list, std::vector<Placement>* placements)
+{
+    placements->clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item == "same")
+            placements->push_back(kPlacementSame);
+        else if (item == "cross")
+            placements->push_back(kPlacementCross);
+        else
+            return false;
+    }
+    return !placements->empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, const char* argv[])
+{
+    uint64_t packetCount = 1000000;
+    uint32_t batchSize = 32;
+    std::vector<uint32_t> packetSizes = { 64, 1024, 16384 };
+    std::vector<uint32_t> capacities = { 64, 1024 };
+    std::vector<WaitStrategy::Policy> policies = {
+        WaitStrategy::kBusySpin, WaitStrategy::kSpinYield,
+        WaitStrategy::kBlocking, WaitStrategy::kHybrid
+    };
+    std::vector<Placement> placements = { kPlacementSame, kPlacementCross };
+    const char* jsonName = nullptr;
+
+    bool usage = false;
+    for (int argi = 1; argi < argc && !usage; ++argi)
+    {
+        const char* option = argv[argi];
+        const char* value = argi+1 < argc ? argv[argi+1] : nullptr;
+        if (!value)
+            usage = true;
+        else if (!strcmp(option, "-n"))
+            packetCount = strtoull(value, NULL, 10);
+        else if (!strcmp(option, "-b"))
+            batchSize = (uint32_t)strtoul(value, NULL, 10);
+        else if (!strcmp(option, "-s"))
+            usage = !parseValues(value, &packetSizes);
+        else if (!strcmp(option, "-c"))
+            usage = !parseValues(value, &capacities);
+        else if (!strcmp(option, "-w"))
+            usage = !parsePolicies(value, &policies);
+        else if (!strcmp(option, "-a"))
+            usage = !parsePlacements(value, &placements);
+        else if (!strcmp(option, "-j"))
+            jsonName = value;
+        else
+            usage = true;
+        ++argi;
+    }
+    for (uint32_t packetSize : packetSizes)
+        usage |= packetSize < sizeof(PacketStamp);
+    for (uint32_t capacity : capacities)
+        usage |= capacity < 2;
+    if (usage || !packetCount || !batchSize)
+    {
+        std::cout << "ringsweep [-n packet count] [-b batch size] [-s sizes] [-c capacities]" << std::endl;
+        std::cout << "          [-w policies] [-a placements] [-j json filename]" << std::endl;
+        std::cout << "  sizes and capacities are comma separated lists (sizes >= 16)" << std::endl;
+        std::cout << "  policies: spin,yield,block,hybrid  placements: same,cross" << std::endl;
+        return 1;
+    }
+
+    int cpuCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount < 2)
+    {
+        std::cout << "only one CPU online, skipping cross placement" << std::endl;
+        placements.erase(std::remove(placements.begin(), placements.end(),
+                                     kPlacementCross), placements.end());
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"packetCount\": " << packetCount
+         << ",\n  \"batchSize\": " << batchSize
+         << ",\n  \"results\": [";
+    bool firstResult = true;
+
+    std::cout << "size     capacity policy placement   packets/sec       MB/sec"
+                 "      p50 ns      p99 ns    p99.9 ns" << std::endl;
+
+    for (uint32_t packetSize : packetSizes)
+    for (uint32_t capacity : capacities)
+    for (WaitStrategy::Policy policy : policies)
+    for (Placement placement : placements)
+    {
+        if (policy == WaitStrategy::kBusySpin && placement == kPlacementSame)
+            continue;
+
+        SweepConfig config;
+        config.packetCount = packetCount;
+        config.packetSize = packetSize;
+        config.capacity = capacity;
+        config.batchSize = batchSize;
+        config.waitPolicy = policy;
+        config.placement = placement;
+        SweepResult result = runSweep(config, cpuCount);
+
+        std::cout.width(8);     std::cout << std::left << packetSize << " ";
+        std::cout.width(8);     std::cout << capacity << " ";
+        std::cout.width(6);     std::cout << WaitStrategy::policyName(policy) << " ";
+        std::cout.width(9);     std::cout << placementName(placement) << std::right;
+        std::cout.width(14);    std::cout << result.packetsPerSec;
+        std::cout.width(13);    std::cout << result.bytesPerSec / (1024*1024);
+        std::cout.width(12);    std::cout << result.p50;
+        std::cout.width(12);    std::cout << result.p99;
+        std::cout.width(12);    std::cout << result.p999;
+        std::cout << (result.valid ? "" : " (SEQUENCE MISMATCH)") << std::endl;
+
+        json << (firstResult ? "\n" : ",\n")
+             << "    { \"packetSize\": " << packetSize
+             << ", \"capacity\": " << capacity
+             << ", \"waitPolicy\": \"" << WaitStrategy::policyName(policy) << "\""
+             << ", \"placement\": \"" << placementName(placement) << "\""
+             << ", \"seconds\": " << result.seconds
+             << ", \"packetsPerSec\": " << result.packetsPerSec
+             << ", \"bytesPerSec\": " << result.bytesPerSec
+             << ", \"latencyNs\": { \"p50\": " << result.p50
+             << ", \"p99\": " << result.p99
+             << ", \"p999\": " << result.p999
+             << ", \"max\": " << result.max << " }"
+             << ", \"valid\": " << (result.valid ? "true" : "false") << " }";
+        firstResult = false;
+    }
+    json << "\n  ]\n}\n";
+
+    if (jsonName)
+    {
+        std::ofstream jsonFile(jsonName);
+        jsonFile << json.str();
+        if (!jsonFile)
+        {
+            std::cout << "failed to write '" << jsonName << "'" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
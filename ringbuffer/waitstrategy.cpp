@@ -0,0 +1,161 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "waitstrategy.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+
+#include <sched.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+WaitStrategy::WaitStrategy(Policy policy, bool processShared) :
+    _policy(policy),
+    _processShared(processShared),
+    _epoch(0),
+    _parked(0)
+{
+#if !defined(__linux__)
+    pthread_mutexattr_t mutexAttr;
+    pthread_mutexattr_init(&mutexAttr);
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    if (processShared)
+    {
+        pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+        pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+    }
+    pthread_mutex_init(&_mutex, &mutexAttr);
+    pthread_cond_init(&_cond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+    pthread_mutexattr_destroy(&mutexAttr);
+#endif
+}
+
+WaitStrategy::~WaitStrategy()
+{
+#if !defined(__linux__)
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+#endif
+}
+
+bool WaitStrategy::parsePolicy(const char* name, Policy* policy)
+{
+    if (!strcmp(name, "spin"))
+        *policy = kBusySpin;
+    else if (!strcmp(name, "yield"))
+        *policy = kSpinYield;
+    else if (!strcmp(name, "block"))
+        *policy = kBlocking;
+    else if (!strcmp(name, "hybrid"))
+        *policy = kHybrid;
+    else
+        return false;
+    return true;
+}
+
+const char* WaitStrategy::policyName(Policy policy)
+{
+    switch (policy)
+    {
+    case kBusySpin:     return "spin";
+    case kSpinYield:    return "yield";
+    case kBlocking:     return "block";
+    case kHybrid:       return "hybrid";
+    }
+    return "unknown";
+}
+
+void WaitStrategy::cpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+void WaitStrategy::yield()
+{
+    sched_yield();
+}
+
+//  Sleeps until the epoch changes from the value read before our final check
+//  of the wait condition.  If notify() already bumped the epoch, we return
+//  immediately.  With a timeout, we may also return once it passes.
+//
+void WaitStrategy::park(uint32_t epoch, int64_t timeoutNs)
+{
+#if defined(__linux__)
+    struct timespec timeout;
+    timeout.tv_sec = (time_t)(timeoutNs / 1000000000);
+    timeout.tv_nsec = (long)(timeoutNs % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch),
+            _processShared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, epoch,
+            timeoutNs < 0 ? NULL : &timeout, NULL, 0);
+#else
+    struct timespec deadline;
+    if (timeoutNs >= 0)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        int64_t nsec = (int64_t)deadline.tv_nsec + timeoutNs % 1000000000;
+        deadline.tv_sec += (time_t)(timeoutNs / 1000000000 + nsec / 1000000000);
+        deadline.tv_nsec = (long)(nsec % 1000000000);
+    }
+    pthread_mutex_lock(&_mutex);
+    while (_epoch.load(std::memory_order_relaxed) == epoch)
+    {
+        if (timeoutNs < 0)
+            pthread_cond_wait(&_cond, &_mutex);
+        else if (pthread_cond_timedwait(&_cond, &_mutex, &deadline) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&_mutex);
+#endif
+}
+
+void WaitStrategy::wakeParked()
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch),
+            _processShared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, INT_MAX,
+            NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&_mutex);
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+#endif
+}
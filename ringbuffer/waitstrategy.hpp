@@ -0,0 +1,201 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samir Sinha
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CK_Sample_WaitStrategy_hpp
+#define CK_Sample_WaitStrategy_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if !defined(__linux__)
+#include <pthread.h>
+#endif
+
+//  How one side of a ring buffer waits on the other.
+//
+//  A WaitStrategy is waited on by one thread (the Consumer waiting for data,
+//  or the Producer waiting for space) and notified by the thread on the other
+//  side after it changes the buffer.
+//
+//      kBusySpin   - spins on the condition.  Lowest latency, but burns a
+//                    core - use only with dedicated cores.
+//      kSpinYield  - spins briefly, then yields the CPU between checks.
+//      kBlocking   - parks the thread on a futex (a condition variable on
+//                    non-Linux platforms) until notified.
+//      kHybrid     - spins, then yields, then parks.
+//
+//  notify() only makes a system call when the waiting thread is actually
+//  parked, so the notifying side's fast path is a fence and a load.  With
+//  the spinning policies notify() does nothing at all.
+//
+//  A processShared WaitStrategy may be placed in memory shared between
+//  processes, to wait on and notify across them.
+//
+class WaitStrategy
+{
+public:
+    enum Policy
+    {
+        kBusySpin,
+        kSpinYield,
+        kBlocking,
+        kHybrid
+    };
+
+    WaitStrategy(Policy policy, bool processShared=false);
+    ~WaitStrategy();
+
+    WaitStrategy(const WaitStrategy&) = delete;
+    WaitStrategy& operator=(const WaitStrategy&) = delete;
+
+    Policy policy() const { return _policy; }
+
+    //  Waits until ready() returns true.
+    template<typename Condition> void wait(Condition ready);
+    //  Waits until ready() returns true, or until timeoutMs passes.  Returns
+    //  false if it timed out.
+    template<typename Condition> bool waitFor(Condition ready, uint32_t timeoutMs);
+    //  Wakes the waiting thread if it's parked.  Must be called after the
+    //  change that makes the waiter's condition true.
+    void notify();
+
+    //  Parses a policy name (spin, yield, block, hybrid.)  Returns false if
+    //  the name isn't recognized.
+    static bool parsePolicy(const char* name, Policy* policy);
+    //  The name parsed by parsePolicy.
+    static const char* policyName(Policy policy);
+
+private:
+    enum
+    {
+        kSpinLimit = 1000,
+        kYieldLimit = 50
+    };
+
+    static void cpuRelax();
+    static void yield();
+    //  a negative timeout parks until woken
+    void park(uint32_t epoch, int64_t timeoutNs=-1);
+    void wakeParked();
+
+    const Policy _policy;
+    const bool _processShared;
+    std::atomic<uint32_t> _epoch;
+    std::atomic<uint32_t> _parked;
+#if !defined(__linux__)
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
+#endif
+};
+
+template<typename Condition> void WaitStrategy::wait(Condition ready)
+{
+    uint32_t attempt = 0;
+    while (!ready())
+    {
+        if (_policy == kBusySpin ||
+            (_policy != kBlocking && attempt < kSpinLimit))
+        {
+            cpuRelax();
+            ++attempt;
+            continue;
+        }
+        if (_policy == kSpinYield ||
+            (_policy == kHybrid && attempt < kSpinLimit + kYieldLimit))
+        {
+            yield();
+            ++attempt;
+            continue;
+        }
+
+        //  announce we're parking before the final check of the condition.
+        //  paired with the fence in notify(), either we see the notifier's
+        //  change or the notifier sees us parked.  the epoch is read with
+        //  acquire so the check can't see older state than the epoch does -
+        //  otherwise we could park on an epoch notify() already bumped.
+        _parked.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t epoch = _epoch.load(std::memory_order_acquire);
+        if (!ready())
+        {
+            park(epoch);
+        }
+        _parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+template<typename Condition> bool WaitStrategy::waitFor(Condition ready, uint32_t timeoutMs)
+{
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    uint32_t attempt = 0;
+    while (!ready())
+    {
+        std::chrono::nanoseconds remaining =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+            return false;
+        if (_policy == kBusySpin ||
+            (_policy != kBlocking && attempt < kSpinLimit))
+        {
+            cpuRelax();
+            ++attempt;
+            continue;
+        }
+        if (_policy == kSpinYield ||
+            (_policy == kHybrid && attempt < kSpinLimit + kYieldLimit))
+        {
+            yield();
+            ++attempt;
+            continue;
+        }
+
+        //  as wait(), parking only until the deadline.
+        _parked.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t epoch = _epoch.load(std::memory_order_acquire);
+        if (!ready())
+        {
+            park(epoch, (int64_t)remaining.count());
+        }
+        _parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+inline void WaitStrategy::notify()
+{
+    if (_policy == kBusySpin || _policy == kSpinYield)
+        return;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_parked.load(std::memory_order_relaxed))
+        return;
+    _epoch.fetch_add(1, std::memory_order_release);
+    wakeParked();
+}
+
+
+#endif